@@ -0,0 +1,42 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "src/nonbreaking_prefix_set.hh"
+
+using moses::tokenizer::NonbreakingPrefixSet;
+
+int usage(char *progname) {
+	std::cerr << "Usage: " << progname << " nonbreaking_prefix.xx nonbreaking_prefix.xx.bin\n"
+	             "\n"
+	             "Compiles a non-breaking prefix file into the binary table the tokenizer\n"
+	             "maps into memory. Put the output in the directory named by the\n"
+	             << NonbreakingPrefixSet::PREFIX_DIR_VARIABLE << " environment variable.\n"
+	          << std::endl;
+	return 1;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc != 3)
+		return usage(argv[0]);
+
+	std::ifstream in(argv[1]);
+	if (!in) {
+		std::cerr << "Could not open " << argv[1] << std::endl;
+		return 1;
+	}
+
+	std::ostringstream data;
+	data << in.rdbuf();
+	NonbreakingPrefixSet prefixes(data.str());
+
+	std::ofstream out(argv[2], std::ios::binary);
+	prefixes.Compile(out);
+	out.close();
+
+	if (!out) {
+		std::cerr << "Could not write " << argv[2] << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef BOUNDED_QUEUE_HH
+#define BOUNDED_QUEUE_HH
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace moses { namespace tokenizer {
+
+/**
+ * Blocking FIFO queue with a maximum size, used to hand work between the
+ * reading and writing ends of a pipeline without the reader running away
+ * with all memory.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(std::size_t capacity)
+	: capacity_(capacity > 0 ? capacity : 1) {
+		//
+	}
+
+	void Push(T &&item) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+		items_.push_back(std::move(item));
+		lock.unlock();
+		not_empty_.notify_one();
+	}
+
+	void Pop(T &item) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		not_empty_.wait(lock, [this] { return !items_.empty(); });
+		item = std::move(items_.front());
+		items_.pop_front();
+		lock.unlock();
+		not_full_.notify_one();
+	}
+
+private:
+	std::size_t capacity_;
+	std::deque<T> items_;
+	std::mutex mutex_;
+	std::condition_variable not_full_;
+	std::condition_variable not_empty_;
+};
+
+} } // end namespace
+
+#endif
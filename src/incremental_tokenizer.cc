@@ -0,0 +1,151 @@
+#include "incremental_tokenizer.hh"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Safe cut in [begin, end) closest to begin + size, or end if there is none.
+std::size_t FindSegmentEnd(std::string const &text, std::size_t begin, std::size_t end, std::size_t size) {
+	using moses::tokenizer::Tokenizer;
+
+	if (end - begin <= size)
+		return end;
+
+	for (std::size_t pos = begin + size; pos > begin; --pos)
+		if (Tokenizer::IsSafeCut(text, pos))
+			return pos;
+
+	for (std::size_t pos = begin + size + 1; pos < end; ++pos)
+		if (Tokenizer::IsSafeCut(text, pos))
+			return pos;
+
+	return end;
+}
+
+} // anonymous namespace
+
+namespace moses { namespace tokenizer {
+
+IncrementalTokenizer::IncrementalTokenizer(Tokenizer const &tokenizer, std::size_t segment_size)
+: tokenizer_(tokenizer),
+  segment_size_(std::max<std::size_t>(segment_size, 1)) {
+	Reset(std::string());
+}
+
+void IncrementalTokenizer::Reset(const std::string &text) {
+	text_ = text;
+	output_.clear();
+	token_offsets_.clear();
+	segments_.clear();
+	Tokenize(0, text_.size(), segments_, output_, token_offsets_);
+}
+
+void IncrementalTokenizer::Edit(std::size_t offset, std::size_t deleted, const std::string &inserted) {
+	if (offset > text_.size() || deleted > text_.size() - offset)
+		throw std::out_of_range("IncrementalTokenizer::Edit: edit beyond the end of the text");
+
+	std::size_t edit_end = offset + deleted;
+
+	// A cut stays safe as long as the characters on and around it don't change
+	// and stay next to each other. Those are up to four bytes each.
+	auto intact = [offset, edit_end](std::size_t cut) {
+		return edit_end + 3 < cut || offset > cut + 4;
+	};
+
+	// Segments that contain the edit
+	auto segment_at = [this](std::size_t pos) -> std::size_t {
+		auto it = std::upper_bound(segments_.begin(), segments_.end(), pos, [](std::size_t pos, Segment const &segment) {
+			return pos < segment.begin;
+		});
+		return it - segments_.begin() - 1;
+	};
+	std::size_t first = segment_at(offset);
+	std::size_t last = segment_at(edit_end);
+
+	// And the ones next to them if the cut in between is affected
+	while (first > 0 && !intact(segments_[first].begin - 1))
+		--first;
+	while (last + 1 < segments_.size() && !intact(segments_[last].end))
+		++last;
+
+	text_.replace(offset, deleted, inserted);
+	std::ptrdiff_t delta = inserted.size() - deleted;
+
+	std::vector<Segment> segments;
+	std::string output;
+	std::vector<std::size_t> token_offsets;
+	Tokenize(segments_[first].begin, segments_[last].end + delta, segments, output, token_offsets);
+
+	// Splice the output
+	std::size_t out_begin = segments_[first].out_begin;
+	std::size_t out_end = segments_[last].out_end;
+	std::ptrdiff_t out_delta = output.size() - (out_end - out_begin);
+	output_.replace(out_begin, out_end - out_begin, output);
+
+	// Splice the token offsets
+	std::size_t first_token = segments_[first].first_token;
+	std::size_t end_token = segments_[last].first_token + segments_[last].token_count;
+	std::ptrdiff_t token_delta = token_offsets.size() - (end_token - first_token);
+	for (std::size_t &token_offset : token_offsets)
+		token_offset += out_begin;
+	for (std::size_t i = end_token; i < token_offsets_.size(); ++i)
+		token_offsets_[i] += out_delta;
+	token_offsets_.erase(token_offsets_.begin() + first_token, token_offsets_.begin() + end_token);
+	token_offsets_.insert(token_offsets_.begin() + first_token, token_offsets.begin(), token_offsets.end());
+
+	// Splice the segments
+	for (Segment &segment : segments) {
+		segment.out_begin += out_begin;
+		segment.out_end += out_begin;
+		segment.first_token += first_token;
+	}
+	for (std::size_t i = last + 1; i < segments_.size(); ++i) {
+		segments_[i].begin += delta;
+		segments_[i].end += delta;
+		segments_[i].out_begin += out_delta;
+		segments_[i].out_end += out_delta;
+		segments_[i].first_token += token_delta;
+	}
+	segments_.erase(segments_.begin() + first, segments_.begin() + last + 1);
+	segments_.insert(segments_.begin() + first, segments.begin(), segments.end());
+}
+
+const std::string &IncrementalTokenizer::Text() const {
+	return text_;
+}
+
+const std::string &IncrementalTokenizer::Output() const {
+	return output_;
+}
+
+const std::vector<std::size_t> &IncrementalTokenizer::TokenOffsets() const {
+	return token_offsets_;
+}
+
+void IncrementalTokenizer::Tokenize(std::size_t begin, std::size_t end, std::vector<Segment> &segments, std::string &output, std::vector<std::size_t> &token_offsets) const {
+	std::string text, tokenized;
+	std::size_t pos = begin;
+	do {
+		std::size_t segment_end = FindSegmentEnd(text_, pos, end, segment_size_);
+		text.assign(text_, pos, segment_end - pos);
+		tokenizer_(text, tokenized);
+
+		// Segments other than the only one always have some output, as they
+		// start or end with a letter or digit.
+		if (!segments.empty())
+			output.push_back(' ');
+
+		Segment segment{pos, segment_end, output.size(), output.size() + tokenized.size(), token_offsets.size(), 0};
+		for (std::size_t i = 0; i < tokenized.size(); ++i)
+			if (tokenized[i] != ' ' && (i == 0 || tokenized[i - 1] == ' '))
+				token_offsets.push_back(segment.out_begin + i);
+		segment.token_count = token_offsets.size() - segment.first_token;
+
+		output.append(tokenized);
+		segments.push_back(segment);
+
+		pos = segment_end + 1; // skip the space we cut at
+	} while (pos < end);
+}
+
+} } // end namespace
@@ -0,0 +1,61 @@
+#ifndef INCREMENTAL_TOKENIZER_HH
+#define INCREMENTAL_TOKENIZER_HH
+
+#include "tokenizer.hh"
+#include <string>
+#include <vector>
+
+namespace moses { namespace tokenizer {
+
+/**
+ * Keeps a text and its tokenized form up to date while the text is edited.
+ * The text is tokenized in segments cut at Tokenizer::IsSafeCut positions. An
+ * edit only re-tokenizes the segments it touches, plus a neighbour when it
+ * changes the characters around the cut to that neighbour. The output is
+ * always the same as tokenizing the whole text again.
+ */
+class IncrementalTokenizer {
+	public:
+		// Segments are cut as close to this many bytes as possible
+		static const std::size_t DEFAULT_SEGMENT_SIZE = 256;
+
+		explicit IncrementalTokenizer(Tokenizer const &tokenizer, std::size_t segment_size = DEFAULT_SEGMENT_SIZE);
+
+		// Starts over with text.
+		void Reset(const std::string &text);
+
+		// Replaces deleted bytes at offset in the text with inserted. Throws
+		// std::out_of_range if that runs past the end of the text.
+		void Edit(std::size_t offset, std::size_t deleted, const std::string &inserted);
+
+		const std::string &Text() const;
+
+		const std::string &Output() const;
+
+		// Offset of the first byte of each token in Output().
+		const std::vector<std::size_t> &TokenOffsets() const;
+	private:
+		struct Segment {
+			std::size_t begin;       // in text_
+			std::size_t end;         // in text_, the cut to the next segment
+			std::size_t out_begin;   // in output_
+			std::size_t out_end;
+			std::size_t first_token; // in token_offsets_
+			std::size_t token_count;
+		};
+
+		// Tokenizes [begin, end) of text_ into new segments. Their output is
+		// joined into output, and their token offsets are relative to it.
+		void Tokenize(std::size_t begin, std::size_t end, std::vector<Segment> &segments, std::string &output, std::vector<std::size_t> &token_offsets) const;
+
+		Tokenizer const &tokenizer_;
+		std::size_t segment_size_;
+		std::string text_;
+		std::string output_;
+		std::vector<std::size_t> token_offsets_;
+		std::vector<Segment> segments_; // never empty, covers all of text_
+};
+
+} } // end namespace
+
+#endif
@@ -0,0 +1,44 @@
+#include "mapped_file.hh"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace moses { namespace tokenizer {
+
+MappedFile::MappedFile(std::string const &path)
+: data_(nullptr),
+  size_(0) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1)
+		throw std::runtime_error("Could not open " + path);
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("Could not open " + path);
+	}
+
+	// mmap refuses a length of 0
+	if (info.st_size == 0) {
+		close(fd);
+		return;
+	}
+
+	void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		throw std::runtime_error("Could not map " + path);
+
+	data_ = static_cast<char const *>(data);
+	size_ = info.st_size;
+}
+
+MappedFile::~MappedFile() {
+	if (data_)
+		munmap(const_cast<char *>(data_), size_);
+}
+
+} } // end namespace
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_HH
+#define MAPPED_FILE_HH
+
+#include <cstddef>
+#include <string>
+
+namespace moses { namespace tokenizer {
+
+/**
+ * Read-only memory mapping of a whole file. Throws std::runtime_error if the
+ * file can't be opened or mapped. Empty files map to an empty range.
+ */
+class MappedFile {
+public:
+	explicit MappedFile(std::string const &path);
+
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	char const *data() const { return data_; }
+
+	std::size_t size() const { return size_; }
+
+private:
+	char const *data_;
+	std::size_t size_;
+};
+
+} } // end namespace
+
+#endif
@@ -1,6 +1,12 @@
 #include "nonbreaking_prefix_set.hh"
 #include "regex.hh"
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <sstream>
 
 namespace moses { namespace tokenizer {
@@ -9,6 +15,8 @@ const std::regex NonbreakingPrefixSet::ONLY_NUMERIC_REGEX = std::regex("^(.+)\\s
 
 const std::regex NonbreakingPrefixSet::EMPTY_OR_COMMENT_REGEX = std::regex("^#.*|^\\s*$");
 
+const char *const NonbreakingPrefixSet::PREFIX_DIR_VARIABLE = "MOSES_NONBREAKING_PREFIX_DIR";
+
 NonbreakingPrefixSet::NonbreakingPrefixSet(std::string const &data) {
 	std::istringstream data_stream(data);
 
@@ -25,6 +33,15 @@ NonbreakingPrefixSet::NonbreakingPrefixSet(std::string const &data) {
 	}
 }
 
+NonbreakingPrefixSet::NonbreakingPrefixSet(std::shared_ptr<PrefixTable const> table)
+: table_(std::move(table)) {
+	//
+}
+
+void NonbreakingPrefixSet::Compile(std::ostream &out) const {
+	PrefixTable::Write(out, text_prefixes, numeric_prefixes);
+}
+
 } } // end namespace
 
 namespace {
@@ -184,24 +201,104 @@ std::unordered_map<std::string, NonbreakingPrefixSet> NONBREAKING_PREFIX_SETS{
 	}
 };
 
+// Languages with a file in the prefix directory, listed the first time they
+// are asked for. Only those get looked up in LOADED_PREFIX_SETS, so asking for
+// made-up languages doesn't fill it up.
+std::unordered_set<std::string> const &ListedLanguages() {
+	static std::unordered_set<std::string> const languages = [] {
+		static std::string const PREFIX = "nonbreaking_prefix.", SUFFIX = ".bin";
+
+		std::unordered_set<std::string> languages;
+		char const *dir = std::getenv(NonbreakingPrefixSet::PREFIX_DIR_VARIABLE);
+		if (!dir || !*dir)
+			return languages;
+
+		DIR *listing = opendir(dir);
+		if (!listing)
+			return languages;
+
+		while (dirent const *entry = readdir(listing)) {
+			std::string name(entry->d_name);
+			if (name.compare(0, PREFIX.size(), PREFIX) != 0)
+				continue;
+
+			name.erase(0, PREFIX.size());
+			if (name.size() > SUFFIX.size() && name.compare(name.size() - SUFFIX.size(), SUFFIX.size(), SUFFIX) == 0)
+				name.erase(name.size() - SUFFIX.size());
+			languages.insert(name);
+		}
+
+		closedir(listing);
+		return languages;
+	}();
+
+	return languages;
+}
+
+// Sets read from the prefix directory, or nullptr if there was no file.
+std::unordered_map<std::string, std::unique_ptr<NonbreakingPrefixSet>> LOADED_PREFIX_SETS;
+
+std::mutex LOADED_PREFIX_SETS_MUTEX;
+
+std::unique_ptr<NonbreakingPrefixSet> LoadPrefixSet(std::string const &dir, std::string const &language) {
+	std::string path = dir + "/nonbreaking_prefix." + language;
+
+	try {
+		std::shared_ptr<moses::tokenizer::PrefixTable const> table(new moses::tokenizer::PrefixTable(path + ".bin"));
+		return std::unique_ptr<NonbreakingPrefixSet>(new NonbreakingPrefixSet(table));
+	} catch (std::runtime_error const &e) {
+		// Fall back to the text file if there is no (valid) compiled one
+		if (std::ifstream(path + ".bin"))
+			std::cerr << "Ignoring " << path << ".bin: " << e.what() << std::endl;
+	}
+
+	std::ifstream file(path);
+	if (!file)
+		return nullptr;
+
+	std::ostringstream data;
+	data << file.rdbuf();
+	return std::unique_ptr<NonbreakingPrefixSet>(new NonbreakingPrefixSet(data.str()));
+}
+
 }
 
 namespace moses { namespace tokenizer {
 
 bool NonbreakingPrefixSet::IsNonbreakingPrefix(string_type const &token) const {
+	if (table_)
+		return table_->Find(token) & PrefixTable::TEXT;
 	return text_prefixes.find(token) != text_prefixes.end();
 }
 
 bool NonbreakingPrefixSet::IsNumericNonbreakingPrefix(string_type const &token) const {
+	if (table_)
+		return table_->Find(token) & PrefixTable::NUMERIC;
 	return numeric_prefixes.find(token) != numeric_prefixes.end();
 }
 
 NonbreakingPrefixSet const &NonbreakingPrefixSet::get(std::string const &language) {
+	char const *dir = std::getenv(PREFIX_DIR_VARIABLE);
+	if (dir && *dir && ListedLanguages().count(language) > 0) {
+		std::lock_guard<std::mutex> lock(LOADED_PREFIX_SETS_MUTEX);
+
+		auto it = LOADED_PREFIX_SETS.find(language);
+		if (it == LOADED_PREFIX_SETS.end())
+			it = LOADED_PREFIX_SETS.emplace(language, ::LoadPrefixSet(dir, language)).first;
+
+		if (it->second)
+			return *it->second;
+	}
+
 	auto it = NONBREAKING_PREFIX_SETS.find(language);
 	if (it != NONBREAKING_PREFIX_SETS.end())
 		return it->second;
 	else
-		return NONBREAKING_PREFIX_SETS.find("en")->second;
+		return get("en"); // built-in en always exists
+}
+
+bool NonbreakingPrefixSet::has(std::string const &language) {
+	return NONBREAKING_PREFIX_SETS.count(language) > 0 || ListedLanguages().count(language) > 0;
 }
 
 } } // end namespace
@@ -2,6 +2,9 @@
 #define NONBREAKING_PREFIX_SET_HH
 
 #include "regex.hh" // for string_type
+#include "prefix_table.hh"
+#include <memory>
+#include <ostream>
 #include <string>
 #include <unordered_set>
 #include <regex>
@@ -17,14 +20,31 @@ public:
 
 	NonbreakingPrefixSet(std::string const &data);
 
+	// Prefixes are looked up in a compiled table instead, see PrefixTable.
+	explicit NonbreakingPrefixSet(std::shared_ptr<PrefixTable const> table);
+
 	bool IsNonbreakingPrefix(string_type const &token) const;
 
 	bool IsNumericNonbreakingPrefix(string_type const &token) const;
 
+	// Writes the set in the format PrefixTable reads.
+	void Compile(std::ostream &out) const;
+
+	// If the environment variable named by PREFIX_DIR_VARIABLE points to a
+	// directory, nonbreaking_prefix.<language>.bin (compiled table) or
+	// nonbreaking_prefix.<language> (text) in there is used. Otherwise the
+	// built-in set for language, or the one for English if there is none.
 	static NonbreakingPrefixSet const &get(std::string const &language);
+
+	// Whether get(language) finds a set for language itself, not English. The
+	// prefix directory is only listed once.
+	static bool has(std::string const &language);
+
+	static const char *const PREFIX_DIR_VARIABLE;
 private:
 	std::unordered_set<string_type> text_prefixes;
 	std::unordered_set<string_type> numeric_prefixes;
+	std::shared_ptr<PrefixTable const> table_;
 
 	static const std::regex ONLY_NUMERIC_REGEX;
 	static const std::regex EMPTY_OR_COMMENT_REGEX;
@@ -0,0 +1,125 @@
+#include "prefix_table.hh"
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+const char MAGIC[8] = {'M', 'T', 'N', 'B', 'P', 'F', 'X', '1'};
+
+const std::size_t HEADER_SIZE = sizeof(MAGIC) + 2 * sizeof(uint32_t);
+
+bool IsLittleEndian() {
+	uint32_t one = 1;
+	unsigned char first;
+	std::memcpy(&first, &one, 1);
+	return first == 1;
+}
+
+void WriteUInt32(std::ostream &out, uint32_t value) {
+	char bytes[4] = {
+		static_cast<char>(value & 0xFF),
+		static_cast<char>((value >> 8) & 0xFF),
+		static_cast<char>((value >> 16) & 0xFF),
+		static_cast<char>((value >> 24) & 0xFF)
+	};
+	out.write(bytes, sizeof(bytes));
+}
+
+} // anonymous namespace
+
+namespace moses { namespace tokenizer {
+
+PrefixTable::PrefixTable(std::string const &path)
+: file_(path) {
+	if (!IsLittleEndian())
+		throw std::runtime_error("Prefix tables can only be mapped on little-endian machines");
+
+	if (file_.size() < HEADER_SIZE)
+		throw std::runtime_error(path + " is not a prefix table");
+
+	char const *bytes = file_.data();
+	uint32_t bucket_count, pool_size;
+	std::memcpy(&bucket_count, bytes + sizeof(MAGIC), sizeof(uint32_t));
+	std::memcpy(&pool_size, bytes + sizeof(MAGIC) + sizeof(uint32_t), sizeof(uint32_t));
+
+	if (std::memcmp(bytes, MAGIC, sizeof(MAGIC)) != 0
+		|| bucket_count == 0 || (bucket_count & (bucket_count - 1)) != 0
+		|| file_.size() != HEADER_SIZE + bucket_count * sizeof(Bucket) + pool_size * sizeof(uint32_t))
+		throw std::runtime_error(path + " is not a prefix table");
+
+	mask_ = bucket_count - 1;
+	buckets_ = reinterpret_cast<Bucket const *>(bytes + HEADER_SIZE);
+	pool_ = reinterpret_cast<uint32_t const *>(bytes + HEADER_SIZE + bucket_count * sizeof(Bucket));
+
+	// Check once that every entry points into the pool so Find doesn't have to.
+	for (uint32_t i = 0; i <= mask_; ++i)
+		if (buckets_[i].flags != 0 && (buckets_[i].offset > pool_size || buckets_[i].length > pool_size - buckets_[i].offset))
+			throw std::runtime_error(path + " is not a prefix table");
+}
+
+uint32_t PrefixTable::Hash(string_type const &token) {
+	// FNV-1a over the code points, so the hash doesn't depend on std::hash
+	uint32_t hash = 2166136261u;
+	for (char_type chr : token) {
+		hash ^= static_cast<uint32_t>(chr);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+uint32_t PrefixTable::Find(string_type const &token) const {
+	uint32_t hash = Hash(token);
+	for (uint32_t i = hash & mask_, probes = 0; probes <= mask_; i = (i + 1) & mask_, ++probes) {
+		Bucket const &bucket = buckets_[i];
+		if (bucket.flags == 0)
+			return 0;
+
+		if (bucket.hash == hash
+			&& bucket.length == token.size()
+			&& std::equal(token.begin(), token.end(), pool_ + bucket.offset, [](char_type a, uint32_t b) { return static_cast<uint32_t>(a) == b; }))
+			return bucket.flags;
+	}
+	return 0;
+}
+
+void PrefixTable::Write(std::ostream &out, std::unordered_set<string_type> const &text_prefixes, std::unordered_set<string_type> const &numeric_prefixes) {
+	// Ordered, so the same input always gives the same file
+	std::map<string_type, uint32_t> entries;
+	for (string_type const &prefix : text_prefixes)
+		entries[prefix] |= TEXT;
+	for (string_type const &prefix : numeric_prefixes)
+		entries[prefix] |= NUMERIC;
+
+	// At most half full
+	uint32_t bucket_count = 1;
+	while (bucket_count < 2 * entries.size())
+		bucket_count <<= 1;
+
+	std::vector<Bucket> buckets(bucket_count, Bucket{0, 0, 0, 0});
+	std::vector<uint32_t> pool;
+	for (auto const &entry : entries) {
+		uint32_t hash = Hash(entry.first);
+		uint32_t i = hash & (bucket_count - 1);
+		while (buckets[i].flags != 0)
+			i = (i + 1) & (bucket_count - 1);
+
+		buckets[i] = Bucket{hash, static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(entry.first.size()), entry.second};
+		pool.insert(pool.end(), entry.first.begin(), entry.first.end());
+	}
+
+	out.write(MAGIC, sizeof(MAGIC));
+	WriteUInt32(out, bucket_count);
+	WriteUInt32(out, pool.size());
+	for (Bucket const &bucket : buckets) {
+		WriteUInt32(out, bucket.hash);
+		WriteUInt32(out, bucket.offset);
+		WriteUInt32(out, bucket.length);
+		WriteUInt32(out, bucket.flags);
+	}
+	for (uint32_t chr : pool)
+		WriteUInt32(out, chr);
+}
+
+} } // end namespace
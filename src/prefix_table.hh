@@ -0,0 +1,60 @@
+#ifndef PREFIX_TABLE_HH
+#define PREFIX_TABLE_HH
+
+#include "regex.hh" // for string_type
+#include "mapped_file.hh"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+
+namespace moses { namespace tokenizer {
+
+/**
+ * Read-only hash table of non-breaking prefixes, memory-mapped straight from
+ * a file written by PrefixTable::Write(). Lookups happen in the mapped memory,
+ * so loading costs nothing beyond the mmap call.
+ *
+ * File layout, all integers little-endian:
+ *   header:  magic "MTNBPFX1", uint32 bucket count (power of two),
+ *            uint32 code point count of the string pool
+ *   buckets: per bucket uint32 hash, uint32 pool offset, uint32 length and
+ *            uint32 flags (see below). Flags 0 means the bucket is empty.
+ *   pool:    UTF-32 code points of all prefixes back to back
+ * Collisions are resolved by linear probing.
+ */
+class PrefixTable {
+public:
+	enum Flags : uint32_t {
+		TEXT    = 1 << 0,
+		NUMERIC = 1 << 1
+	};
+
+	// Maps the file. Throws std::runtime_error if it can't be read or doesn't
+	// look like a prefix table.
+	explicit PrefixTable(std::string const &path);
+
+	// Flags of token, or 0 if it isn't in the table.
+	uint32_t Find(string_type const &token) const;
+
+	static void Write(std::ostream &out, std::unordered_set<string_type> const &text_prefixes, std::unordered_set<string_type> const &numeric_prefixes);
+
+private:
+	struct Bucket {
+		uint32_t hash;
+		uint32_t offset;
+		uint32_t length;
+		uint32_t flags;
+	};
+
+	static uint32_t Hash(string_type const &token);
+
+	MappedFile file_;
+	uint32_t mask_;
+	Bucket const *buckets_;
+	uint32_t const *pool_;
+};
+
+} } // end namespace
+
+#endif
@@ -1,26 +1,198 @@
 #include "regex.hh"
+#include <algorithm>
 #include <iostream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace moses { namespace tokenizer {
 
 /**
  * Helpers
  */
 
-void StrToUChar(std::string const &str, string_type &vec) {
-	typedef boost::u8_to_u32_iterator<std::string::const_iterator, char_type> conv_type;
-	vec.clear();
-	vec.reserve(str.size());
-	std::copy(conv_type(str.begin(), str.begin(), str.end()),
-	          conv_type(str.end(),   str.begin(), str.end()),
-	          std::back_inserter(vec));
+namespace {
+
+const char_type REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Lone low surrogates U+DC80-U+DCFF stand in for undecodable bytes 0x80-0xFF
+const char_type ESCAPED_BYTE = 0xDC00;
+
+/**
+ * Decodes a single code point starting at in, which must point to a byte of
+ * 0x80 or higher. On invalid input it writes the replacement for the longest
+ * valid prefix of a sequence (at least one byte) and continues after it.
+ */
+inline void DecodeSequence(unsigned char const *&in, unsigned char const *end, char_type *&out, InvalidUTF8 invalid) {
+	unsigned char lead = *in;
+	std::size_t length;
+	char_type chr;
+	unsigned char min = 0x80, max = 0xBF; // allowed range of the second byte
+
+	if (lead >= 0xC2 && lead <= 0xDF) {
+		length = 2;
+		chr = lead & 0x1F;
+	} else if (lead >= 0xE0 && lead <= 0xEF) {
+		length = 3;
+		chr = lead & 0x0F;
+		if (lead == 0xE0) min = 0xA0; // overlong
+		if (lead == 0xED) max = 0x9F; // surrogates
+	} else if (lead >= 0xF0 && lead <= 0xF4) {
+		length = 4;
+		chr = lead & 0x07;
+		if (lead == 0xF0) min = 0x90; // overlong
+		if (lead == 0xF4) max = 0x8F; // beyond U+10FFFF
+	} else {
+		length = 0;
+		chr = 0;
+	}
+
+	std::size_t valid = length > 0 ? 1 : 0;
+	for (; valid > 0 && valid < length && in + valid != end; ++valid) {
+		unsigned char byte = in[valid];
+		if (byte < (valid == 1 ? min : 0x80) || byte > (valid == 1 ? max : 0xBF))
+			break;
+		chr = (chr << 6) | (byte & 0x3F);
+	}
+
+	if (length > 0 && valid == length) {
+		*out++ = chr;
+		in += length;
+		return;
+	}
+
+	// Invalid: replace the maximal subpart, which is at least the lead byte.
+	std::size_t skip = std::max<std::size_t>(valid, 1);
+	if (invalid == InvalidUTF8::pass) {
+		for (std::size_t i = 0; i < skip; ++i)
+			*out++ = ESCAPED_BYTE + in[i];
+	} else {
+		*out++ = REPLACEMENT_CHARACTER;
+	}
+	in += skip;
+}
+
+inline void EncodeCodePoint(char_type chr, char *&out) {
+	if (chr >= 0xDC80 && chr <= 0xDCFF) {
+		*out++ = static_cast<char>(chr - ESCAPED_BYTE);
+		return;
+	}
+
+	if (chr < 0 || chr > 0x10FFFF || (chr >= 0xD800 && chr <= 0xDFFF))
+		chr = REPLACEMENT_CHARACTER;
+
+	if (chr < 0x80) {
+		*out++ = static_cast<char>(chr);
+	} else if (chr < 0x800) {
+		*out++ = static_cast<char>(0xC0 | (chr >> 6));
+		*out++ = static_cast<char>(0x80 | (chr & 0x3F));
+	} else if (chr < 0x10000) {
+		*out++ = static_cast<char>(0xE0 | (chr >> 12));
+		*out++ = static_cast<char>(0x80 | ((chr >> 6) & 0x3F));
+		*out++ = static_cast<char>(0x80 | (chr & 0x3F));
+	} else {
+		*out++ = static_cast<char>(0xF0 | (chr >> 18));
+		*out++ = static_cast<char>(0x80 | ((chr >> 12) & 0x3F));
+		*out++ = static_cast<char>(0x80 | ((chr >> 6) & 0x3F));
+		*out++ = static_cast<char>(0x80 | (chr & 0x3F));
+	}
+}
+
+} // anonymous namespace
+
+void StrToUChar(std::string const &str, string_type &vec, InvalidUTF8 invalid) {
+	// Every byte yields at most one code point
+	vec.resize(str.size());
+
+	unsigned char const *in = reinterpret_cast<unsigned char const *>(str.data());
+	unsigned char const *const end = in + str.size();
+	char_type *out = vec.data();
+
+	while (in != end) {
+#ifdef __SSE2__
+		// Fast path: widen blocks of 16 ASCII bytes in one go.
+		const __m128i zero = _mm_setzero_si128();
+		while (end - in >= 16) {
+			__m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in));
+			int non_ascii = _mm_movemask_epi8(block);
+			if (non_ascii != 0) {
+				// Copy the ASCII bytes before the first non-ASCII one
+				for (int n = __builtin_ctz(non_ascii); n > 0; --n)
+					*out++ = *in++;
+				break;
+			}
+
+			__m128i low = _mm_unpacklo_epi8(block, zero);
+			__m128i high = _mm_unpackhi_epi8(block, zero);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out),      _mm_unpacklo_epi16(low, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4),  _mm_unpackhi_epi16(low, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8),  _mm_unpacklo_epi16(high, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 12), _mm_unpackhi_epi16(high, zero));
+			in += 16;
+			out += 16;
+		}
+
+		if (in == end)
+			break;
+#endif
+
+		if (*in < 0x80)
+			*out++ = *in++;
+		else
+			DecodeSequence(in, end, out, invalid);
+	}
+
+	vec.resize(out - vec.data());
 }
 
 void UCharToStr(string_type const &vec, std::string &str) {
-	typedef boost::u32_to_u8_iterator<string_type::const_iterator> conv_type;
-	str.clear();
-	str.reserve(vec.size());
-	std::copy(conv_type(vec.begin()), conv_type(vec.end()), std::back_inserter(str));
+	UCharToStr(vec.begin(), vec.end(), str);
+}
+
+void UCharToStr(string_type::const_iterator begin, string_type::const_iterator end, std::string &str) {
+	// Room for the all-ASCII case; grows when it turns out to be too small.
+	str.resize(std::distance(begin, end));
+	std::size_t pos = 0;
+
+	for (string_type::const_iterator it = begin; it != end;) {
+#ifdef __SSE2__
+		// Fast path: narrow blocks of 16 ASCII code points in one go.
+		const __m128i non_ascii_bits = _mm_set1_epi32(~0x7F);
+		const __m128i zero = _mm_setzero_si128();
+		while (end - it >= 16) {
+			__m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&*it));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&*it + 4));
+			__m128i c = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&*it + 8));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&*it + 12));
+			__m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, non_ascii_bits), zero)) != 0xFFFF)
+				break;
+
+			if (str.size() - pos < 16)
+				str.resize(std::max(2 * str.size(), pos + 16));
+
+			__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&str[pos]), bytes);
+			it += 16;
+			pos += 16;
+		}
+
+		if (it == end)
+			break;
+#endif
+
+		// Slow path for (at most) a block's worth of code points
+		if (str.size() - pos < 4 * 16)
+			str.resize(std::max(2 * str.size(), pos + 4 * 16));
+
+		char *out = &str[pos];
+		for (string_type::const_iterator block_end = it + std::min<std::ptrdiff_t>(16, end - it); it != block_end; ++it)
+			EncodeCodePoint(*it, out);
+		pos = out - str.data();
+	}
+
+	str.resize(pos);
 }
 
 string_type StrToUChar(std::string const &str) {
@@ -35,35 +207,207 @@ std::ostream &operator <<(std::ostream &out, string_type const &vec) {
 	return out << str;
 }
 
+namespace {
+
+thread_local Budget *current_budget = nullptr;
+
+} // anonymous namespace
+
+Budget::Budget(std::size_t max_steps, std::chrono::microseconds max_time)
+: max_steps_(max_steps),
+  steps_(0),
+  deadline_(std::chrono::steady_clock::now() + max_time),
+  has_deadline_(max_time.count() > 0),
+  previous_(current_budget) {
+	if (max_steps > 0 || has_deadline_)
+		current_budget = this;
+}
+
+Budget::~Budget() {
+	if (current_budget == this)
+		current_budget = previous_;
+}
+
+void Budget::Check() {
+	Budget *budget = current_budget;
+	if (!budget)
+		return;
+
+	if (budget->max_steps_ > 0 && ++budget->steps_ > budget->max_steps_)
+		throw BudgetExceeded();
+
+	if (budget->has_deadline_ && std::chrono::steady_clock::now() > budget->deadline_)
+		throw BudgetExceeded();
+}
+
 ReplaceOp::ReplaceOp(std::string const &pattern, std::string const &replacement, std::string const &original_pattern)
 : pattern_(original_pattern),
   regex_(boost::make_u32regex(pattern, boost::regex::perl)),
-  replacement_(replacement) {
-  	//
+  replacement_(replacement),
+  branches_(1, Branch{0, {}}) {
+	if (!ParseReplacement(replacement_, 0, branches_[0].segments))
+		branches_.clear();
 }
 
 ReplaceOp::ReplaceOp(std::string const &pattern, std::string const &replacement)
-: pattern_(pattern),
-  regex_(boost::make_u32regex(pattern, boost::regex::perl)),
-  replacement_(replacement) {
-  	//
+: ReplaceOp(pattern, replacement, pattern) {
+	//
+}
+
+ReplaceOp::ReplaceOp(std::vector<ReplaceOp> const &ops) {
+	// Each op becomes an alternative wrapped in a capture group, so we can tell
+	// which one matched: (op1)|(op2)|...
+	std::basic_string<char_type> pattern;
+	std::size_t group = 1;
+	for (ReplaceOp const &op : ops) {
+		if (!pattern.empty())
+			pattern.push_back('|');
+		pattern.push_back('(');
+		pattern.append(op.regex_.str());
+		pattern.push_back(')');
+
+		branches_.push_back(Branch{group, {}});
+		if (!ParseReplacement(op.replacement_, group, branches_.back().segments))
+			throw std::invalid_argument("Cannot fuse replacement: " + op.replacement_);
+
+		pattern_ += (pattern_.empty() ? "(" : "|(") + op.pattern_ + ")";
+		group += 1 + op.regex_.mark_count();
+	}
+
+	regex_ = boost::make_u32regex(pattern.begin(), pattern.end(), boost::regex::perl);
+}
+
+bool ReplaceOp::ParseReplacement(std::string const &replacement_str, std::size_t offset, std::vector<Segment> &segments) {
+	string_type replacement(StrToUChar(replacement_str));
+	segments.clear();
+
+	auto literal = [&segments](char_type chr) {
+		if (segments.empty() || segments.back().group != -1)
+			segments.push_back(Segment{string_type(), -1});
+		segments.back().text.push_back(chr);
+	};
+
+	for (auto it = replacement.begin(); it != replacement.end(); ++it) {
+		if (*it == '\\' || *it == '(' || *it == ')' || *it == '?') {
+			// Escapes and (with format_all) conditionals: leave it to boost
+			return false;
+		} else if (*it != '$') {
+			literal(*it);
+		} else if (it + 1 != replacement.end() && *(it + 1) == '$') {
+			literal(*++it);
+		} else if (it + 1 != replacement.end() && *(it + 1) == '&') {
+			++it;
+			segments.push_back(Segment{string_type(), static_cast<int>(offset)});
+		} else if (it + 1 != replacement.end() && *(it + 1) >= '0' && *(it + 1) <= '9') {
+			int group = 0;
+			while (it + 1 != replacement.end() && *(it + 1) >= '0' && *(it + 1) <= '9')
+				group = group * 10 + (*++it - '0');
+			segments.push_back(Segment{string_type(), static_cast<int>(offset) + group});
+		} else if (it + 1 != replacement.end() && *(it + 1) == '{') {
+			auto close = std::find(it + 2, replacement.end(), '}');
+			if (close == it + 2 || close == replacement.end() || !std::all_of(it + 2, close, [](char_type chr) { return chr >= '0' && chr <= '9'; }))
+				return false;
+			int group = 0;
+			for (auto digit = it + 2; digit != close; ++digit)
+				group = group * 10 + (*digit - '0');
+			segments.push_back(Segment{string_type(), static_cast<int>(offset) + group});
+			it = close;
+		} else {
+			return false;
+		}
+	}
+
+	return true;
 }
 
 void ReplaceOp::operator()(string_type &text, string_type &out) const {
+	Budget::Check();
 	out.clear();
-	boost::u32regex_replace(std::back_inserter(out), text.begin(), text.end(), regex_, replacement_);
+	match_type match;
+	(*this)(text.begin(), text.end(), out, match);
 	// std::cerr << "Pattern: s/" << pattern_ << "/" << replacement_ << "/g\n"
 	//           << "     In: " << text << "\n"
 	//           << "    Out: " << out << std::endl;
 }
 
+void ReplaceOp::operator()(LineBatch &text, LineBatch &out) const {
+	Budget::Check();
+	out.clear();
+	out.text.reserve(text.text.size());
+	match_type match;
+	for (std::size_t line = 0; line < text.size(); ++line) {
+		(*this)(text.begin(line), text.end(line), out.text, match);
+		out.EndLine();
+	}
+}
+
+void ReplaceOp::operator()(string_type::const_iterator begin, string_type::const_iterator end, string_type &out, match_type &match) const {
+	if (branches_.empty()) {
+		boost::u32regex_replace(std::back_inserter(out), begin, end, regex_, replacement_);
+		return;
+	}
+
+	// Same walk over the matches as regex_replace does with its regex_iterator,
+	// but without the allocations and without parsing the replacement each time.
+	auto last = begin;
+	boost::match_flag_type flags = boost::match_default;
+	while (boost::u32regex_search(last, end, match, regex_, flags, begin)) {
+		out.insert(out.end(), last, match[0].first);
+
+		auto branch = branches_.begin();
+		while (!match[branch->group].matched)
+			++branch;
+
+		for (Segment const &segment : branch->segments) {
+			if (segment.group == -1)
+				out.insert(out.end(), segment.text.begin(), segment.text.end());
+			else if (static_cast<std::size_t>(segment.group) < match.size() && match[segment.group].matched)
+				out.insert(out.end(), match[segment.group].first, match[segment.group].second);
+		}
+		last = match[0].second;
+
+		flags = boost::match_default;
+		if (match.length() == 0)
+			flags |= boost::regex_constants::match_not_initial_null;
+	}
+
+	out.insert(out.end(), last, end);
+}
+
+ReplaceChainOp::ReplaceChainOp(std::vector<ReplaceOp> const &ops)
+: ops_(ops) {
+	//
+}
+
+// Same dance as ChainOp: every op leaves its result in text for the next one,
+// and the last swap puts it in out.
+void ReplaceChainOp::operator()(string_type &text, string_type &out) const {
+	for (ReplaceOp const &op : ops_) {
+		op(text, out);
+		std::swap(text, out);
+	}
+	std::swap(text, out);
+}
+
+void ReplaceChainOp::operator()(LineBatch &text, LineBatch &out) const {
+	for (ReplaceOp const &op : ops_) {
+		op(text, out);
+		std::swap(text, out);
+	}
+	std::swap(text, out);
+}
+
 SearchOp::SearchOp(std::string const &pattern)
 : regex_(boost::make_u32regex(pattern, boost::regex::perl)) {
 	//
 }
 
 bool SearchOp::operator()(string_type const &text) const {
-	return boost::u32regex_search(text.begin(), text.end(), regex_);
+	return (*this)(text.begin(), text.end());
+}
+
+bool SearchOp::operator()(string_type::const_iterator begin, string_type::const_iterator end) const {
+	return boost::u32regex_search(begin, end, regex_);
 }
 
 /**
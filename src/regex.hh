@@ -1,7 +1,11 @@
 #ifndef PERL_REGEX
 #define PERL_REGEX
 
+#include <chrono>
+#include <functional>
+#include <stdexcept>
 #include <string>
+#include <vector>
 #include <boost/regex/icu.hpp>
 #include <boost/container_hash/hash.hpp>
 
@@ -11,36 +15,167 @@ typedef UChar32 char_type;
 
 typedef std::vector<char_type> string_type;
 
-void StrToUChar(std::string const &str, string_type &vec);
+/**
+ * What StrToUChar does with bytes that are not valid UTF-8. Each maximal
+ * invalid subsequence (as defined by the Unicode standard) either becomes a
+ * single U+FFFD, or each of its bytes becomes a lone surrogate U+DC80-U+DCFF
+ * that UCharToStr turns back into the original byte. Either way, decoding
+ * never fails.
+ */
+enum class InvalidUTF8 {
+	replace,
+	pass
+};
 
+void StrToUChar(std::string const &str, string_type &vec, InvalidUTF8 invalid = InvalidUTF8::replace);
+
+// Lone surrogates U+DC80-U+DCFF are written as the byte they stand for, other
+// code points that can't be encoded become U+FFFD.
 void UCharToStr(string_type const &vec, std::string &str);
 
+void UCharToStr(string_type::const_iterator begin, string_type::const_iterator end, std::string &str);
+
 string_type StrToUChar(std::string const &str); // handy
 
+/**
+ * Limits the work the ops below may do on the current thread while this object
+ * lives. Every pass of a ReplaceOp over the text counts as a step, including
+ * each one a LoopOp repeats. Searches don't: they are the conditions of loops,
+ * or quick checks on single tokens. Once either limit is exceeded, the next
+ * ReplaceOp throws BudgetExceeded. A limit of 0 means no limit.
+ */
+class Budget {
+public:
+	Budget(std::size_t max_steps, std::chrono::microseconds max_time);
+	~Budget();
+
+	Budget(Budget const &) = delete;
+	Budget &operator=(Budget const &) = delete;
+
+	// Called by ReplaceOp before each pass.
+	static void Check();
+
+private:
+	std::size_t max_steps_;
+	std::size_t steps_;
+	std::chrono::steady_clock::time_point deadline_;
+	bool has_deadline_;
+	Budget *previous_;
+};
+
+class BudgetExceeded : public std::runtime_error {
+public:
+	BudgetExceeded() : std::runtime_error("budget exceeded") {}
+};
+
+/**
+ * Many lines stored back to back in a single buffer. Line i runs from
+ * offsets[i] up to offsets[i + 1]. All ops run on each line separately, never
+ * looking beyond its boundaries, so no rule can match across lines.
+ */
+struct LineBatch {
+	string_type text;
+	std::vector<std::size_t> offsets;
+
+	LineBatch() : offsets{0} {}
+
+	std::size_t size() const {
+		return offsets.size() - 1;
+	}
+
+	string_type::const_iterator begin(std::size_t line) const {
+		return text.begin() + offsets[line];
+	}
+
+	string_type::const_iterator end(std::size_t line) const {
+		return text.begin() + offsets[line + 1];
+	}
+
+	void clear() {
+		text.clear();
+		offsets.resize(1);
+	}
+
+	// Marks everything appended to text since the last call as a line.
+	void EndLine() {
+		offsets.push_back(text.size());
+	}
+};
+
 class ReplaceOp {
 public:
+	typedef boost::match_results<string_type::const_iterator> match_type;
+
 	ReplaceOp(std::string const &pattern, std::string const &replacement, std::string const &original_pattern);
 	ReplaceOp(std::string const &pattern, std::string const &replacement);
+
+	// Single pass that does what applying all ops one after the other does, as
+	// long as they don't interact. See Fuse().
+	explicit ReplaceOp(std::vector<ReplaceOp> const &ops);
+
 	void operator()(string_type &text, string_type &out) const;
+	void operator()(LineBatch &text, LineBatch &out) const;
+
+	// Appends the replaced version of [begin, end) to out, using match as
+	// scratch space.
+	void operator()(string_type::const_iterator begin, string_type::const_iterator end, string_type &out, match_type &match) const;
 private:
+	// Piece of the replacement: either literal text or a capture group.
+	struct Segment {
+		string_type text;
+		int group; // -1 for literal text
+	};
+
+	// Replacement for when the expression matched because capture group
+	// `group` matched. For normal ops that is always group 0.
+	struct Branch {
+		std::size_t group;
+		std::vector<Segment> segments;
+	};
+
+	// Parses replacement into segments, with capture group numbers shifted by
+	// offset. Returns false if it uses anything beyond $n, ${n}, $& and $$.
+	static bool ParseReplacement(std::string const &replacement, std::size_t offset, std::vector<Segment> &segments);
+
 	std::string pattern_;
 	boost::u32regex regex_;
 	std::string replacement_;
+	std::vector<Branch> branches_;
 };
 
 class SearchOp {
 public:
 	SearchOp(std::string const &pattern);
 	bool operator()(string_type const &text) const;
+	bool operator()(string_type::const_iterator begin, string_type::const_iterator end) const;
 private:
 	boost::u32regex regex_;
 };
 
+/**
+ * Replace ops applied one after the other, like Chain() does, for when they
+ * come as a list. The runtime counterpart of ChainOp, as ReplaceOp's list
+ * constructor is that of Fuse().
+ */
+class ReplaceChainOp {
+public:
+	explicit ReplaceChainOp(std::vector<ReplaceOp> const &ops);
+
+	void operator()(string_type &text, string_type &out) const;
+	void operator()(LineBatch &text, LineBatch &out) const;
+private:
+	std::vector<ReplaceOp> ops_;
+};
+
 template <typename... T>
 struct ChainOp {
 	inline void operator()(string_type &text, string_type &out) const {
 		std::swap(text, out);
 	}
+
+	inline void operator()(LineBatch &text, LineBatch &out) const {
+		std::swap(text, out);
+	}
 };
 
 template <typename T, typename... R>
@@ -56,6 +191,12 @@ struct ChainOp<T, R...> {
 		rest(text, out);
 	}
 
+	inline void operator()(LineBatch &text, LineBatch &out) const {
+		op(text, out);
+		std::swap(text, out);
+		rest(text, out);
+	}
+
 	T op;
 	ChainOp<R...> rest;
 };
@@ -85,12 +226,87 @@ struct LoopOp {
 		}
 		finalize(text, out);
 	}
+
+	// Same as above, but every line loops on its own: the operation is only
+	// applied to the lines for which the condition still holds.
+	void operator()(LineBatch &text, LineBatch &out) const
+	{
+		initial(text, out);
+		std::swap(out, text);
+
+		std::vector<std::size_t> active;
+		for (std::size_t line = 0; line < text.size(); ++line)
+			if (condition(text.begin(line), text.end(line)))
+				active.push_back(line);
+
+		LineBatch subset, subset_out;
+		while (!active.empty()) {
+			subset.clear();
+			for (std::size_t line : active) {
+				subset.text.insert(subset.text.end(), text.begin(line), text.end(line));
+				subset.EndLine();
+			}
+
+			operation(subset, subset_out);
+
+			// Put the changed lines back in place
+			out.clear();
+			for (std::size_t line = 0, next = 0; line < text.size(); ++line) {
+				if (next < active.size() && active[next] == line) {
+					out.text.insert(out.text.end(), subset_out.begin(next), subset_out.end(next));
+					++next;
+				} else {
+					out.text.insert(out.text.end(), text.begin(line), text.end(line));
+				}
+				out.EndLine();
+			}
+			std::swap(out, text);
+
+			std::size_t still_active = 0;
+			for (std::size_t line : active)
+				if (condition(text.begin(line), text.end(line)))
+					active[still_active++] = line;
+			active.resize(still_active);
+		}
+
+		finalize(text, out);
+	}
 };
 
 struct Noop {
 	void operator()(string_type &text, string_type &out) const {
 		std::swap(text, out);
 	}
+
+	void operator()(LineBatch &text, LineBatch &out) const {
+		std::swap(text, out);
+	}
+};
+
+/**
+ * Holds any of the ops above, for when which one to use is only known at
+ * runtime.
+ */
+class AnyOp {
+public:
+	AnyOp() = default;
+
+	template <typename T> AnyOp(T const &op)
+	: line_op_(op), batch_op_(op) {
+		//
+	}
+
+	void operator()(string_type &text, string_type &out) const {
+		line_op_(text, out);
+	}
+
+	void operator()(LineBatch &text, LineBatch &out) const {
+		batch_op_(text, out);
+	}
+
+private:
+	std::function<void(string_type &, string_type &)> line_op_;
+	std::function<void(LineBatch &, LineBatch &)> batch_op_;
 };
 
 /**
@@ -101,6 +317,17 @@ SearchOp Search(const std::string &pattern);
 
 ReplaceOp Replace(const std::string &pattern, const std::string &replacement);
 
+/**
+ * Combines replace ops into a single op that does all of them in one pass
+ * over the text. Only correct if the ops don't interact: none of them may
+ * match anything another one produces, and their matches may not overlap,
+ * as their context is no longer rescanned between them.
+ */
+template <typename... T> ReplaceOp
+Fuse(T&&... args) {
+	return ReplaceOp(std::vector<ReplaceOp>{std::forward<T>(args)...});
+}
+
 template <typename... T> ChainOp<T...>
 Chain(T&&... args) {
 	return ChainOp<T...>(std::forward<T>(args)...);
@@ -0,0 +1,188 @@
+#include "sentence_splitter.hh"
+#include <algorithm>
+
+namespace {
+
+using moses::tokenizer::Replace;
+using moses::tokenizer::Chain;
+using moses::tokenizer::string_type;
+using moses::tokenizer::char_type;
+
+typedef boost::match_results<string_type::const_iterator> match_type;
+
+// Perl's \p{IsUpper}, the inside of a [] class: Lu plus Other_Uppercase, which
+// [:upper:] leaves out. That is circled and roman numeral capitals.
+const std::string UPPER("[:upper:]\\x{2160}-\\x{216F}\\x{24B6}-\\x{24CF}\\x{1F130}-\\x{1F149}\\x{1F150}-\\x{1F169}\\x{1F170}-\\x{1F189}");
+
+// Characters that may start a sentence, as the inside of a [] class.
+std::string SentenceStart(std::string const &language) {
+	std::string start(UPPER + "0-9");
+
+	// Indic scripts have no case
+	if (language == "hi" || language == "mr")
+		start += "\\x{0900}-\\x{097F}\\x{A8E0}-\\x{A8FF}"; // Devanagari (Extended)
+	else if (language == "gu")
+		start += "\\x{0A80}-\\x{0AFF}"; // Gujarati
+	else if (language == "as" || language == "bn" || language == "mni")
+		start += "\\x{0980}-\\x{09FF}"; // Bengali
+	else if (language == "kn")
+		start += "\\x{0C80}-\\x{0CFF}"; // Kannada
+	else if (language == "ml")
+		start += "\\x{0D00}-\\x{0D7F}"; // Malayalam
+	else if (language == "or")
+		start += "\\x{0B00}-\\x{0B7F}"; // Oriya
+	else if (language == "pa")
+		start += "\\x{0A00}-\\x{0A7F}"; // Gurmukhi
+	else if (language == "ta")
+		start += "\\x{0B80}-\\x{0BFF}"; // Tamil
+	else if (language == "te")
+		start += "\\x{0C00}-\\x{0C7F}"; // Telugu
+
+	return start;
+}
+
+// The rules that don't need to look at non-breaking prefixes.
+moses::tokenizer::AnyOp BreakOp(std::string const &language) {
+	std::string start(SentenceStart(language));
+
+	return Chain(
+		// Non-period end of sentence markers (?!) followed by sentence starters.
+		Replace("([?!\\x{0964}\\x{0965}]) +(['\"(\\[¿¡[:Pi:]]*[" + start + "])", "$1\n$2"),
+		// Multi-dots followed by sentence starters.
+		Replace("(\\.[\\.]+) +(['\"(\\[¿¡[:Pi:]]*[" + start + "])", "$1\n$2"),
+		// Add breaks for sentences that end with some sort of punctuation
+		// inside a quote or parenthetical and are followed by a possible
+		// sentence starter punctuation and upper case.
+		Replace("([?!\\.\\x{0964}\\x{0965}][ ]*[\\x{300D}\\x{300F}'\")\\][:Pf:]]+) +(['\"(\\[¿¡[:Pi:]]*[ ]*[" + start + "])", "$1\n$2"),
+		// Add breaks for sentences that end with some sort of punctuation,
+		// and are followed by a sentence starter punctuation and upper case.
+		Replace("([?!\\.\\x{0964}\\x{0965}]) +([\\x{300D}\\x{300F}'\"(\\[¿¡[:Pi:]]+[ ]*[" + start + "])", "$1\n$2")
+	);
+}
+
+// Word ending in periods. Group 1 is the possible prefix, group 2 any
+// closing punctuation between it and the periods.
+const boost::u32regex ENDS_WITH_PERIOD = boost::make_u32regex("([[:alnum:]\\.\\-]*)(['\")\\]%[:Pf:]]*)(\\.+)\\z", boost::regex::perl);
+
+// Upper case acronym, like U.S.A.
+const boost::u32regex ACRONYM = boost::make_u32regex("\\.[" + UPPER + "\\-]+\\.+\\z", boost::regex::perl);
+
+// Some opening quotes or brackets, then upper case or a number.
+const boost::u32regex STARTS_SENTENCE = boost::make_u32regex("\\A[ ]*['\"(\\[¿¡[:Pi:]]*[ ]*[" + UPPER + "0-9]", boost::regex::perl);
+
+// Languages split-sentences.perl has rules of its own for.
+const char *const CJK_LANGUAGES[] = {"zh", "yue", "ja"};
+
+bool StartsWithDigit(string_type::const_iterator begin, string_type::const_iterator end) {
+	return begin != end && *begin >= '0' && *begin <= '9';
+}
+
+} // anonymous namespace
+
+namespace moses { namespace tokenizer {
+
+SentenceSplitter::SentenceSplitter(const std::string &language)
+: language_(language),
+  prefix_set_(NonbreakingPrefixSet::get(language)),
+  break_op_(BreakOp(language)) {
+	//
+}
+
+bool SentenceSplitter::IsSupportedLanguage(const std::string &language) {
+	return std::find(std::begin(CJK_LANGUAGES), std::end(CJK_LANGUAGES), language) == std::end(CJK_LANGUAGES);
+}
+
+bool SentenceSplitter::EndsSentence(string_type::const_iterator word, string_type::const_iterator word_end, string_type::const_iterator next, string_type::const_iterator next_end) const {
+	match_type match;
+	if (!boost::u32regex_search(word, word_end, match, ENDS_WITH_PERIOD))
+		return false;
+
+	string_type prefix(match[1].first, match[1].second);
+	bool starting_punct = match[2].matched && match[2].length() > 0;
+
+	// Perl considers the prefix "0" false
+	bool has_prefix = !prefix.empty() && !(prefix.size() == 1 && prefix[0] == '0');
+
+	// Known honorific, never break
+	if (has_prefix && !starting_punct && prefix_set_.IsNonbreakingPrefix(prefix))
+		return false;
+
+	// Upper case acronym
+	if (boost::u32regex_search(word, word_end, ACRONYM))
+		return false;
+
+	if (!boost::u32regex_search(next, next_end, STARTS_SENTENCE))
+		return false;
+
+	// Numeric-only prefix followed by a number
+	if (has_prefix && !starting_punct && prefix_set_.IsNumericNonbreakingPrefix(prefix) && StartsWithDigit(next, next_end))
+		return false;
+
+	return true;
+}
+
+std::vector<string_type> &SentenceSplitter::operator()(const string_type &paragraph, std::vector<string_type> &sentences) const {
+	sentences.clear();
+
+	// Collapse spaces and trim
+	string_type tmp1, tmp2;
+	tmp1.reserve(paragraph.size());
+	for (char_type chr : paragraph)
+		if (chr != ' ' || (!tmp1.empty() && tmp1.back() != ' '))
+			tmp1.push_back(chr);
+	if (!tmp1.empty() && tmp1.back() == ' ')
+		tmp1.pop_back();
+
+	if (tmp1.empty())
+		return sentences;
+
+	break_op_(tmp1, tmp2);
+	std::swap(tmp1, tmp2);
+
+	// Check all remaining periods, word by word. Words may contain the breaks
+	// added above, just like in the perl script.
+	tmp2.clear();
+	auto begin = tmp1.cbegin(), end = tmp1.cend();
+	auto word = begin, word_end = std::find(word, end, ' ');
+	while (word_end != end) {
+		auto next = word_end + 1, next_end = std::find(next, end, ' ');
+
+		tmp2.insert(tmp2.end(), word, word_end);
+		tmp2.push_back(EndsSentence(word, word_end, next, next_end) ? '\n' : ' ');
+
+		word = next;
+		word_end = next_end;
+	}
+	tmp2.insert(tmp2.end(), word, word_end);
+
+	// Every line is a sentence, without spaces around it
+	for (auto line = tmp2.cbegin(); line != tmp2.cend();) {
+		auto line_end = std::find(line, tmp2.cend(), '\n');
+
+		auto first = line, last = line_end;
+		while (first != last && *first == ' ')
+			++first;
+		while (last != first && *(last - 1) == ' ')
+			--last;
+
+		if (first != last)
+			sentences.emplace_back(first, last);
+
+		line = line_end == tmp2.cend() ? line_end : line_end + 1;
+	}
+
+	return sentences;
+}
+
+std::vector<std::string> &SentenceSplitter::operator()(const std::string &paragraph, std::vector<std::string> &sentences) const {
+	std::vector<string_type> decoded;
+	(*this)(StrToUChar(paragraph), decoded);
+
+	sentences.resize(decoded.size());
+	for (std::size_t i = 0; i < decoded.size(); ++i)
+		UCharToStr(decoded[i], sentences[i]);
+
+	return sentences;
+}
+
+} } // end namespace
@@ -0,0 +1,41 @@
+#ifndef SENTENCE_SPLITTER_HH
+#define SENTENCE_SPLITTER_HH
+
+#include "regex.hh"
+#include "nonbreaking_prefix_set.hh"
+#include <string>
+#include <vector>
+
+namespace moses { namespace tokenizer {
+
+/**
+ * Port of the Moses split-sentences.perl rules. Works on a single paragraph
+ * at a time and uses the same NonbreakingPrefixSet as the Tokenizer for the
+ * same language.
+ */
+class SentenceSplitter {
+	public:
+		SentenceSplitter(const std::string &language);
+
+		// Whether the rules apply to language. split-sentences.perl splits
+		// Chinese, Cantonese and Japanese on punctuation of their own, which is
+		// not ported.
+		static bool IsSupportedLanguage(const std::string &language);
+
+		// Splits paragraph into sentences. Spaces are cleaned up the way the perl
+		// script does it: runs of spaces become one, and sentences are trimmed.
+		std::vector<string_type> &operator()(const string_type &paragraph, std::vector<string_type> &sentences) const;
+
+		std::vector<std::string> &operator()(const std::string &paragraph, std::vector<std::string> &sentences) const;
+	private:
+		// Whether to end the sentence after word, given the word after it.
+		bool EndsSentence(string_type::const_iterator word, string_type::const_iterator word_end, string_type::const_iterator next, string_type::const_iterator next_end) const;
+
+		std::string language_;
+		NonbreakingPrefixSet const &prefix_set_;
+		AnyOp break_op_;
+};
+
+} } // end namespace
+
+#endif
@@ -0,0 +1,67 @@
+#include "token_stream.hh"
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+void AppendUInt32(std::string &out, uint32_t value) {
+	out.push_back(static_cast<char>(value & 0xFF));
+	out.push_back(static_cast<char>((value >> 8) & 0xFF));
+	out.push_back(static_cast<char>((value >> 16) & 0xFF));
+	out.push_back(static_cast<char>((value >> 24) & 0xFF));
+}
+
+bool ReadUInt32(std::istream &in, uint32_t &value) {
+	unsigned char bytes[4];
+	if (!in.read(reinterpret_cast<char *>(bytes), sizeof(bytes)))
+		return false;
+
+	value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+	return true;
+}
+
+} // anonymous namespace
+
+namespace moses { namespace tokenizer {
+
+void EncodeTokens(std::vector<std::string> const &tokens, std::string &out) {
+	AppendUInt32(out, tokens.size());
+	for (std::string const &token : tokens) {
+		AppendUInt32(out, token.size());
+		out.append(token);
+	}
+}
+
+void WriteTokens(std::ostream &out, std::vector<std::string> const &tokens) {
+	std::string record;
+	EncodeTokens(tokens, record);
+	out.write(record.data(), record.size());
+}
+
+bool ReadTokens(std::istream &in, std::vector<std::string> &tokens) {
+	tokens.clear();
+
+	uint32_t count;
+	if (!ReadUInt32(in, count)) {
+		if (in.gcount() == 0)
+			return false;
+		throw std::runtime_error("Truncated token record");
+	}
+
+	// Grows as tokens are read, so a corrupt count can't allocate much
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t length;
+		if (!ReadUInt32(in, length))
+			throw std::runtime_error("Truncated token record");
+
+		std::string token;
+		token.resize(length);
+		if (length > 0 && !in.read(&token[0], length))
+			throw std::runtime_error("Truncated token record");
+		tokens.push_back(std::move(token));
+	}
+
+	return true;
+}
+
+} } // end namespace
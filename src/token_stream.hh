@@ -0,0 +1,30 @@
+#ifndef TOKEN_STREAM_HH
+#define TOKEN_STREAM_HH
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace moses { namespace tokenizer {
+
+/**
+ * Binary token format, for consumers that want the tokens themselves rather
+ * than a line of escaped text to split again. Each line is stored as
+ *   uint32 number of tokens
+ *   per token: uint32 length in bytes, followed by that many bytes of UTF-8
+ * All integers are little-endian. There are no separators and no escaping.
+ */
+
+// Appends the record for tokens to out.
+void EncodeTokens(std::vector<std::string> const &tokens, std::string &out);
+
+void WriteTokens(std::ostream &out, std::vector<std::string> const &tokens);
+
+// Reads the next record. Returns false at the end of the stream, throws
+// std::runtime_error if the stream ends halfway through a record.
+bool ReadTokens(std::istream &in, std::vector<std::string> &tokens);
+
+} } // end namespace
+
+#endif
@@ -1,6 +1,10 @@
 #include "tokenizer.hh"
 #include "regex.hh"
+#include "tokenizer_rules.hh"
 #include "nonbreaking_prefix_set.hh"
+#include "whitespace.hh"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <regex>
@@ -8,92 +12,55 @@
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <unicode/utypes.h>
+#include <unicode/uchar.h>
+#include <unicode/utf8.h>
 
 
 namespace {
 
 using moses::tokenizer::Search;
 using moses::tokenizer::Replace;
+using moses::tokenizer::ReplaceOp;
+using moses::tokenizer::ReplaceChainOp;
 using moses::tokenizer::Chain;
+using moses::tokenizer::Fuse;
 using moses::tokenizer::Loop;
 using moses::tokenizer::Noop;
 using moses::tokenizer::string_type;
+using moses::tokenizer::UCharToStr;
 using moses::tokenizer::char_type;
-
-auto DeduplicateSpace = Replace(R"([\s]+)", " ");
-
-auto RemoveASCIIJunk = Replace(R"([\x00-\x1F])", "");
+using moses::tokenizer::Tokenizer;
 
 auto PadNonAlphanumeric = Replace(R"(([^[:alnum:]\s\.'`,-]))", " $1 ");
 
-auto FiSvPadNonAlphanumeric = Chain(
-	// in Finnish and Swedish, the colon can be used inside words as an apostrophe-like character:
-	// USA:n, 20:een, EU:ssa, USA:s, S:t
-	Replace(R"(([^[:alnum:]\s\.:'`,-]))", " $1 "),
-	// if a colon is not immediately followed by lower-case characters, separate it out anyway
-	Replace(R"((:)(?=$|[^[:Ll:]]))", " $1 ")
-);
+// The second rule only looks at colons, which the first leaves alone, and its
+// lookahead doesn't consume the next character, so both can go in one pass.
+auto FiSvPadNonAlphanumeric = ReplaceOp(moses::tokenizer::FiSvPadNonAlphanumericRules());
 
-auto CaPadNonAlphanumeric = Chain(
-	// in Catalan, the middle dot can be used inside words: il�lusio
-	Replace(R"(([^[:alnum:]\s\.·'`,-]))", " $1 "),
-	// if a middot is not immediately followed by lower-case characters, separate it out anyway
-	Replace(R"((·)(?=$|[^[:Ll:]]))", " $1 ")
-);
+// Same story as for Finnish and Swedish
+auto CaPadNonAlphanumeric = ReplaceOp(moses::tokenizer::CaPadNonAlphanumericRules());
 
 auto AggressiveHyphenSplit = Replace(R"(([[:alnum:]])\-(?=[[:alnum:]]))", "$1 @-@ ");
 
-auto SeparateCommaInNumbers = Chain(
-	// separate out "," except if within numbers (5,300)
-   // previous "global" application skips some:  A,B,C,D,E > A , B,C , D,E
-   // first application uses up B so rule can't see B,C
-   // two-step version here may create extra spaces but these are removed later
-   // will also space digit,letter or letter,digit forms (redundant with next section)
-	Replace("([^[:Number:]])[,]", "$1 , "),
-	Replace("[,]([^[:Number:]])", " , $1"),
-	// Separate "," after a number if it's the end of a sentence
-	Replace("([[:Number:]])[,]$", "$1 , ")
-);
+// Can't be fused: the second rule matches the ", " the first one produces.
+auto SeparateCommaInNumbers = ReplaceChainOp(moses::tokenizer::SeparateCommaInNumbersRules());
 
-auto EnSpecificApostrophe = Chain(
-	// Split contractions right
-	Replace("([^[:alpha:]])[']([^[:alpha:]])", "$1 ' $2"),
-	Replace("([^[:alpha:][:Number:]])[']([[:alpha:]])", "$1 ' $2"),
-	Replace("([[:alpha:]])[']([^[:alpha:]])", "$1 ' $2"),
-	Replace("([[:alpha:]])[']([[:alpha:]])", "$1 '$2"),
-	// Special case for "1990's"
-	Replace("([[:Number:]])[']([s])", "$1 '$2")
-);
+// The apostrophe rules can't be fused: each rule consumes the characters
+// around an apostrophe, which hides them from the match on the next
+// apostrophe in the same pass. E.g. "a''b" splits differently in one pass.
+auto EnSpecificApostrophe = ReplaceChainOp(moses::tokenizer::EnSpecificApostropheRules());
 
-auto FrItGaCaSpecificApostrophe = Chain(
-	// Split contractions left
-	Replace("([^[:alpha:]])[']([^[:alpha:]])", "$1 ' $2"),
-  Replace("([^[:alpha:]])[']([[:alpha:]])", "$1 ' $2"),
-  Replace("([[:alpha:]])[']([^[:alpha:]])", "$1 ' $2"),
-  Replace("([[:alpha:]])[']([[:alpha:]])", "$1' $2")
-);
+auto FrItGaCaSpecificApostrophe = ReplaceChainOp(moses::tokenizer::FrItGaCaSpecificApostropheRules());
 
-auto SoSpecificApostrophe = Chain(
-	// Don't split glottals
-	Replace("([^[:alpha:]])[']([^[:alpha:]])", "$1 ' $2"),
-  Replace("([^[:alpha:]])[']([[:alpha:]])", "$1 ' $2"),
-  Replace("([[:alpha:]])[']([^[:alpha:]])", "$1 ' $2")
-);
+auto SoSpecificApostrophe = ReplaceChainOp(moses::tokenizer::SoSpecificApostropheRules());
 
 auto NonSpecificApostrophe = Replace("'", " ' ");
 
 auto TrailingDotApostrophe = Replace("\\.' ?$", " . ' ");
 
-auto EscapeSpecialChars = Chain(
-	Replace("&", "&amp;"),   // escape escape
-	Replace("\\|", "&#124;"),  // factor separator
-	Replace("<", "&lt;"),    // xml
-	Replace(">", "&gt;"),    // xml
-	Replace("'", "&apos;"),  // xml
-	Replace("\"", "&quot;"),  // xml
-	Replace("\\[", "&#91;"),   // syntax non-terminal
-	Replace("\\]", "&#93;")    // syntax non-terminal
-);
+// Fused: none of the replacements contain a character that is escaped by a
+// later rule, so one pass gives the same result.
+auto EscapeSpecialChars = ReplaceOp(moses::tokenizer::EscapeSpecialCharsRules());
 
 auto ReplaceMultidot = Loop(
 	Replace("\\.([\\.]+)", " DOTMULTI$1"),
@@ -141,21 +108,6 @@ bool TokenEndsWithPeriod(string_type const &str, string_type &prefix) {
 	return true;
 }
 
-void Trim(string_type &vec) {
-	auto begin = vec.begin();
-	auto end = vec.end();
-	
-	while (begin != end && IsWhitespace(*begin))
-		++begin;
-
-	while (end != begin && IsWhitespace(*(end-1)))
-		--end;
-
-	// Should be safe, we're never "trimming" something to something longer
-	std::copy(begin, end, vec.begin());
-	vec.resize(std::distance(begin, end));
-}
-
 class SplitIterator {
 public:
 	SplitIterator(string_type::const_iterator offset, string_type::const_iterator end)
@@ -201,12 +153,178 @@ private:
 	string_type::const_iterator end_pos_;
 };
 
+// Code point that ends at pos, or a negative value if there is none or it is
+// not valid UTF-8.
+char_type CodePointBefore(std::string const &text, std::size_t pos) {
+	if (pos == 0)
+		return -1;
+
+	// Only look at the last few bytes so the offsets fit in an int32_t
+	std::size_t start = pos < U8_MAX_LENGTH ? 0 : pos - U8_MAX_LENGTH;
+	int32_t i = pos - start;
+	char_type chr;
+	U8_PREV(reinterpret_cast<uint8_t const *>(text.data() + start), 0, i, chr);
+	return chr;
+}
+
+// Code point that starts at pos, or a negative value like above.
+char_type CodePointAt(std::string const &text, std::size_t pos) {
+	if (pos >= text.size())
+		return -1;
+
+	int32_t i = 0;
+	int32_t length = std::min<std::size_t>(text.size() - pos, U8_MAX_LENGTH);
+	char_type chr;
+	U8_NEXT(reinterpret_cast<uint8_t const *>(text.data() + pos), i, length, chr);
+	return chr;
+}
+
+// Whether chr is an ASCII character that the PadNonAlphanumeric ops of every
+// language turn into a token of its own.
+bool IsPaddedSymbol(char chr) {
+	return chr != '\0' && std::strchr("!\"#$%&()*+/;<=>?@[\\]^{|}~", chr) != nullptr;
+}
+
+// Whether chr ends the word it follows: whitespace or a padded symbol.
+bool IsWordBoundary(char chr) {
+	return chr == ' ' || (chr >= '\t' && chr <= '\r') || IsPaddedSymbol(chr);
+}
+
+bool IsDotMultiLetter(char_type chr) {
+	return chr == 'D' || chr == 'O' || chr == 'T' || chr == 'M' || chr == 'U' || chr == 'L' || chr == 'I';
+}
+
+// Whether chr can be next to a space that a window ends at, as long as
+// HandleNonbreakingPrefixes gets to see the character after the space: none
+// of the rules look across it for anything but apostrophes and commas, and
+// NormalizeWhitespace mustn't remove chr.
+bool IsLookaheadNeighbour(char_type chr) {
+	return chr > 0x20 && !u_isspace(chr) && chr != '\'' && chr != ',';
+}
+
+// Like IsSafeCut, but with a lookahead.
+bool IsLookaheadCut(std::string const &text, std::size_t pos) {
+	return (text[pos] == ' ' || text[pos] == '\t')
+	    && IsLookaheadNeighbour(CodePointBefore(text, pos))
+	    && IsLookaheadNeighbour(CodePointAt(text, pos + 1));
+}
+
+// Whether a window may end right before or after a padded symbol at pos. The
+// symbol ends up between spaces anyway, so this is the same as the above.
+bool IsSymbolCut(std::string const &text, std::size_t pos) {
+	return (IsPaddedSymbol(text[pos]) && IsLookaheadNeighbour(CodePointBefore(text, pos)))
+	    || (IsPaddedSymbol(text[pos - 1]) && IsLookaheadNeighbour(CodePointAt(text, pos)));
+}
+
+// Whether a window may end between two letters or digits at pos, gluing the
+// outputs back together. Holds as long as the token around pos doesn't end
+// with a period, as HandleNonbreakingPrefixes would look at all of it, and
+// pos isn't inside a literal DOTMULTI.
+bool IsWordCut(std::string const &text, std::size_t pos) {
+	char_type before = CodePointBefore(text, pos), after = CodePointAt(text, pos);
+	return before >= 0 && after >= 0
+	    && u_isalnum(before) && u_isalnum(after)
+	    && !(IsDotMultiLetter(before) && IsDotMultiLetter(after));
+}
+
+// Where a window ends and the next one starts. The outputs of both are joined
+// by a space, or glued together if the window was cut inside a word.
+struct Cut {
+	std::size_t end;
+	std::size_t next;
+	bool glue;
+};
+
+// Ends the window that starts at offset at most size bytes further, at the
+// last cut that doesn't change the outcome. Without one, it is cut at size
+// bytes anyway, which keeps the memory use bounded at the cost of possibly
+// splitting or joining a token or two around the cut.
+Cut FindWindowEnd(std::string const &text, std::size_t offset, std::size_t size) {
+	if (text.size() - offset <= size)
+		return Cut{text.size(), text.size(), false};
+
+	std::size_t limit = offset + size;
+
+	// Whether the rest of the word from pos onwards contains a period. Don't
+	// look further than a window to find out.
+	bool dotted = false;
+	for (std::size_t pos = limit; pos < text.size() && !IsWordBoundary(text[pos]); ++pos) {
+		if (text[pos] == '.' || pos - limit >= size) {
+			dotted = true;
+			break;
+		}
+	}
+
+	for (std::size_t pos = limit; pos > offset; --pos) {
+		if (IsWordBoundary(text[pos]))
+			dotted = false;
+		else if (text[pos] == '.')
+			dotted = true;
+
+		if (Tokenizer::IsSafeCut(text, pos) || IsLookaheadCut(text, pos))
+			return Cut{pos, pos + 1, false};
+
+		if (IsSymbolCut(text, pos))
+			return Cut{pos, pos, false};
+
+		if (!dotted && IsWordCut(text, pos))
+			return Cut{pos, pos, true};
+	}
+
+	// Don't cut a code point in half, nor split a word where it can be helped.
+	std::size_t pos = limit;
+	while (pos > offset + 1 && U8_IS_TRAIL(text[pos]))
+		--pos;
+	char_type before = CodePointBefore(text, pos), after = CodePointAt(text, pos);
+	return Cut{pos, pos, before >= 0 && after >= 0 && u_isalnum(before) && u_isalnum(after)};
+}
+
+// Appends the space separated tokens in [begin, end) to out, joined by a
+// space. With glue, the first one continues the last token in out instead.
+void AppendTokens(string_type::const_iterator begin, string_type::const_iterator end, std::string &out, bool glue) {
+	if (begin == end)
+		return;
+
+	// Most lines are a single window, write those straight into out.
+	if (out.empty()) {
+		UCharToStr(begin, end, out);
+		return;
+	}
+
+	std::string encoded;
+	UCharToStr(begin, end, encoded);
+	if (!glue)
+		out.push_back(' ');
+	out.append(encoded);
+}
+
+// Same, but each token becomes an item of out.
+void AppendTokens(string_type::const_iterator begin, string_type::const_iterator end, std::vector<std::string> &out, bool glue) {
+	std::string token;
+	for (string_type::const_iterator it = begin; it != end; glue = false) {
+		string_type::const_iterator token_end = std::find(it, end, ' ');
+		if (token_end != it) {
+			UCharToStr(it, token_end, token);
+			if (glue && !out.empty())
+				out.back().append(token);
+			else
+				out.push_back(token);
+		}
+		it = token_end == end ? end : token_end + 1;
+	}
+}
+
 } // anonymous namespace
 
 namespace moses { namespace tokenizer {
 
 Tokenizer::Tokenizer(const std::string &language, Options options)
 : options_(options),
+	invalid_utf8_((options & Options::pass_invalid_utf8) == Options::pass_invalid_utf8 ? InvalidUTF8::pass : InvalidUTF8::replace),
+	window_size_(DEFAULT_WINDOW_SIZE),
+	max_steps_(0),
+	max_time_(0),
+	fallback_count_(0),
 	language_(language),
   prefix_set_(NonbreakingPrefixSet::get(language)) {
   if (language_ == "fi" || language_ == "sv")
@@ -226,23 +344,156 @@ Tokenizer::Tokenizer(const std::string &language, Options options)
 		apostrophe_op_ = ::NonSpecificApostrophe;
 }
 
+void Tokenizer::SetWindowSize(std::size_t size) {
+	window_size_ = size;
+}
+
+void Tokenizer::SetBudget(std::size_t max_steps, std::chrono::microseconds max_time) {
+	max_steps_ = max_steps;
+	max_time_ = max_time;
+}
+
+// None of the rules match across such a space: they all need a bit of
+// punctuation next to it. The token in front of it doesn't end with a period
+// either, so the next token is of no interest to HandleNonbreakingPrefixes.
+bool Tokenizer::IsSafeCut(const std::string &text, std::size_t pos) {
+	if (text[pos] != ' ' && text[pos] != '\t')
+		return false;
+
+	char_type before = ::CodePointBefore(text, pos), after = ::CodePointAt(text, pos + 1);
+	return before >= 0 && after >= 0 && u_isalnum(before) && u_isalnum(after);
+}
+
+bool Tokenizer::IsKnownLanguage(const std::string &language) {
+	// Those that the constructor picks rules for
+	static const std::string LANGUAGES_WITH_RULES[] = {"fi", "sv", "ca", "en", "fr", "it", "ga", "so"};
+
+	return NonbreakingPrefixSet::has(language)
+	    || std::find(std::begin(LANGUAGES_WITH_RULES), std::end(LANGUAGES_WITH_RULES), language) != std::end(LANGUAGES_WITH_RULES);
+}
+
+std::size_t Tokenizer::FallbackCount() const {
+	return fallback_count_;
+}
+
 std::string &Tokenizer::operator()(const std::string &text, std::string &out) const {
+	return Tokenize(text, out);
+}
+
+std::vector<std::string> &Tokenizer::operator()(const std::string &text, std::vector<std::string> &tokens) const {
+	return Tokenize(text, tokens);
+}
+
+std::string &Tokenizer::operator()(const string_type &text, std::string &out) const {
+	// Long ones take the windowed path. Code points are at least a byte each, so
+	// this catches every line operator() would split.
+	if (window_size_ > 0 && text.size() > window_size_) {
+		std::string str;
+		UCharToStr(text, str);
+		return (*this)(str, out);
+	}
+
 	string_type tmp1, tmp2;
-	StrToUChar(text, tmp1);
+	try {
+		Budget budget(max_steps_, max_time_);
+		tmp1 = text;
+		RunSteps(tmp1, tmp2, 0);
+		UCharToStr(tmp1, out);
+		return out;
+	} catch (BudgetExceeded const &) {
+		// Fall through to TokenizeFallback
+	} catch (boost::regex_error const &) {
+		// Same as below
+	}
 
-	// De-duplicate spaces and clean ASCII junk
-	::DeduplicateSpace(tmp1, tmp2);
-	std::swap(tmp1, tmp2);
-	
-	::RemoveASCIIJunk(tmp1, tmp2);
-	std::swap(tmp1, tmp2);
+	++fallback_count_;
+	tmp1 = text;
+	TokenizeFallback(tmp1, tmp2);
+	UCharToStr(tmp1, out);
+	return out;
+}
+
+template <typename Output>
+Output &Tokenizer::Tokenize(const std::string &text, Output &out) const {
+	// One budget for the whole line, however many windows it takes
+	try {
+		Budget budget(max_steps_, max_time_);
+		return TokenizeWindows(text, out, false);
+	} catch (BudgetExceeded const &) {
+		// Fall through to TokenizeFallback
+	} catch (boost::regex_error const &) {
+		// Boost ran into its own complexity limit. Same deal.
+	}
+
+	++fallback_count_;
+	return TokenizeWindows(text, out, true);
+}
+
+template <typename Output>
+Output &Tokenizer::TokenizeWindows(const std::string &text, Output &out, bool fallback) const {
+	// Long lines are tokenized one window at a time so we never hold more than
+	// a window worth of UTF-32 in memory.
+	out.clear();
+	std::string window;
+	string_type tmp1, tmp2;
+	bool glue = false;
+	for (std::size_t offset = 0; offset < text.size();) {
+		::Cut cut = window_size_ > 0 ? ::FindWindowEnd(text, offset, window_size_) : ::Cut{text.size(), text.size(), false};
+
+		// Most lines fit in a single window, don't copy those.
+		if (offset == 0 && cut.end == text.size()) {
+			StrToUChar(text, tmp1, invalid_utf8_);
+		} else {
+			window.assign(text, offset, cut.end - offset);
+			StrToUChar(window, tmp1, invalid_utf8_);
+		}
+
+		if (fallback)
+			TokenizeFallback(tmp1, tmp2);
+		else
+			RunSteps(tmp1, tmp2, std::max<char_type>(::CodePointAt(text, cut.next), 0));
+
+		::AppendTokens(tmp1.begin(), tmp1.end(), out, glue);
+
+		glue = cut.glue;
+		offset = cut.next;
+	}
+
+	return out;
+}
+
+void Tokenizer::TokenizeFallback(string_type &tmp1, string_type &tmp2) const {
+	NormalizeWhitespace(tmp1);
+
+	// Every character that isn't a letter or digit becomes a token of its own.
+	tmp2.clear();
+	tmp2.reserve(tmp1.size());
+	for (char_type chr : tmp1) {
+		if (chr == ' ' || u_isalnum(chr)) {
+			tmp2.push_back(chr);
+		} else {
+			tmp2.push_back(' ');
+			tmp2.push_back(chr);
+			tmp2.push_back(' ');
+		}
+	}
+	NormalizeWhitespace(tmp2);
+
+	if ((options_ & Options::no_escape) == Options::none)
+		::EscapeSpecialChars(tmp2, tmp1);
+	else
+		std::swap(tmp1, tmp2);
+}
+
+template <typename Buffer>
+void Tokenizer::RunSteps(Buffer &tmp1, Buffer &tmp2, char_type lookahead) const {
+	// De-duplicate spaces, clean ASCII junk and strip heading and trailing
+	// spaces in one go.
+	NormalizeWhitespace(tmp1);
 
 	// If protected patterns
 	// TODO: implement
 
-	// Strips heading and trailing spaces.
-	::Trim(tmp1);
-
 	// Separate out all "other" special characters
 	pad_nonalpha_op_(tmp1, tmp2);
 	std::swap(tmp1, tmp2);
@@ -265,13 +516,11 @@ std::string &Tokenizer::operator()(const std::string &text, std::string &out) co
 	apostrophe_op_(tmp1, tmp2);
 	std::swap(tmp1, tmp2);
 
-  HandleNonbreakingPrefixes(tmp1, tmp2);
+  HandleNonbreakingPrefixes(tmp1, tmp2, lookahead);
 	std::swap(tmp1, tmp2);
 
   // Cleans up extraneous spaces.
-  ::DeduplicateSpace(tmp1, tmp2);
-	std::swap(tmp1, tmp2);
-  ::Trim(tmp1);
+  NormalizeWhitespace(tmp1);
 
   // .' at end of sentence is missed
   ::TrailingDotApostrophe(tmp1, tmp2);
@@ -289,28 +538,88 @@ std::string &Tokenizer::operator()(const std::string &text, std::string &out) co
   	::EscapeSpecialChars(tmp1, tmp2);
 		std::swap(tmp1, tmp2);
   }
+}
 
-  UCharToStr(tmp1, out);
-	return out;
+void Tokenizer::TokenizeBatch(const std::vector<std::string> &lines, std::vector<std::string> &out) const {
+	TokenizeLines(lines, out);
+}
+
+void Tokenizer::TokenizeBatch(const std::vector<std::string> &lines, std::vector<std::vector<std::string>> &out) const {
+	TokenizeLines(lines, out);
+}
+
+template <typename Output>
+void Tokenizer::TokenizeLines(const std::vector<std::string> &lines, std::vector<Output> &out) const {
+	out.resize(lines.size());
+
+	// Lines that go through the batch, the others are done right away.
+	std::vector<std::size_t> batched;
+	batched.reserve(lines.size());
+
+	LineBatch tmp1, tmp2;
+	string_type line;
+	for (std::size_t i = 0; i < lines.size(); ++i) {
+		if (max_steps_ > 0 || max_time_.count() > 0 || (window_size_ > 0 && lines[i].size() > window_size_)) {
+			Tokenize(lines[i], out[i]);
+		} else {
+			StrToUChar(lines[i], line, invalid_utf8_);
+			tmp1.text.insert(tmp1.text.end(), line.begin(), line.end());
+			tmp1.EndLine();
+			batched.push_back(i);
+		}
+	}
+
+	try {
+		RunSteps(tmp1, tmp2, 0);
+	} catch (boost::regex_error const &) {
+		// Let Tokenize deal with whichever line it was
+		for (std::size_t i : batched)
+			Tokenize(lines[i], out[i]);
+		return;
+	}
+
+	for (std::size_t i = 0; i < batched.size(); ++i) {
+		out[batched[i]].clear();
+		::AppendTokens(tmp1.begin(i), tmp1.end(i), out[batched[i]], false);
+	}
+}
+
+void Tokenizer::HandleNonbreakingPrefixes(string_type &text, string_type &out, char_type lookahead) const {
+	out.clear();
+	HandleNonbreakingPrefixes(text.begin(), text.end(), out, lookahead);
 }
 
-void Tokenizer::HandleNonbreakingPrefixes(string_type &text, string_type &out) const {
+void Tokenizer::HandleNonbreakingPrefixes(LineBatch &text, LineBatch &out, char_type) const {
 	out.clear();
-	string_type prefix;
-	for (auto it = SplitIterator(text.begin(), text.end()); it != SplitIterator(text.end(), text.end()); ++it) {
+	for (std::size_t line = 0; line < text.size(); ++line) {
+		HandleNonbreakingPrefixes(text.begin(line), text.end(line), out.text, 0);
+		out.EndLine();
+	}
+}
+
+void Tokenizer::HandleNonbreakingPrefixes(string_type::const_iterator begin, string_type::const_iterator end, string_type &out, char_type lookahead) const {
+	string_type prefix, next;
+	for (auto it = SplitIterator(begin, end); it != SplitIterator(end, end); ++it) {
 		bool split = false;
 
 		if (::TokenEndsWithPeriod(*it, prefix)) {
+			// Only the first character of the next token matters, which for the
+			// last token of a window is the lookahead.
+			if (it.HasNext())
+				next = *(it+1);
+			else
+				next.assign(1, lookahead);
+
 			// Split last words independently as they are unlikely to be non-breaking prefixes
-			if (!it.HasNext()) {
+			if (!it.HasNext() && lookahead == 0) {
 				split = true;
 			} else if (::ContainsDot(prefix) && ::ContainsAlpha(prefix)) {
 				// no change
 			} else if (prefix_set_.IsNonbreakingPrefix(prefix)) {
 				// no change
-			} else if (::StartsLowerCase(*(it+1))) {
+			} else if (::StartsLowerCase(next)) {
 				// no change
-			} else if (::StartsNumeric(*(it+1)) && prefix_set_.IsNumericNonbreakingPrefix(prefix)) {
+			} else if (::StartsNumeric(next) && prefix_set_.IsNumericNonbreakingPrefix(prefix)) {
 				// no change
 			} else {
 				split = true;
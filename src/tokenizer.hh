@@ -3,8 +3,10 @@
 
 #include "regex.hh"
 #include "nonbreaking_prefix_set.hh"
+#include <atomic>
+#include <chrono>
 #include <string>
-#include <functional>
+#include <vector>
 
 namespace moses { namespace tokenizer {
 
@@ -13,19 +15,103 @@ class Tokenizer {
 		enum class Options : uint32_t {
 			none       = 0,
 			aggressive = (1 << 0),
-			no_escape  = (1 << 1)
+			no_escape  = (1 << 1),
+			// Keep invalid UTF-8 bytes as they are instead of replacing them
+			// with U+FFFD. See InvalidUTF8. They are still split off from the
+			// letters around them, like any other symbol.
+			pass_invalid_utf8 = (1 << 2)
 		};
 
+		// Lines longer than this many bytes are tokenized in windows
+		static const std::size_t DEFAULT_WINDOW_SIZE = 1 << 16;
+
 		Tokenizer(const std::string &language, Options options = static_cast<Options>(0));
+
+		// Lines longer than size bytes are split into windows of at most that
+		// size, cut at spaces, symbols or inside words wherever that doesn't
+		// change the outcome. A window with no such place is cut at size bytes
+		// anyway, which may split or join the tokens around the cut. 0 disables
+		// this.
+		void SetWindowSize(std::size_t size);
+
+		// Limits the number of regular expression replace passes (see Budget) and
+		// the time spent on a single line, all of its windows together. Lines
+		// that exceed either limit are tokenized again by TokenizeFallback
+		// instead. 0 means no limit.
+		void SetBudget(std::size_t max_steps, std::chrono::microseconds max_time);
+
+		// Whether text can be cut at pos: a single space or tab between two
+		// letters or digits (u_isalnum). Tokenizing the text on either side
+		// separately gives the same result as tokenizing it as a whole.
+		static bool IsSafeCut(const std::string &text, std::size_t pos);
+
+		// Whether language has rules or nonbreaking prefixes of its own. All
+		// other languages are tokenized the same way.
+		static bool IsKnownLanguage(const std::string &language);
+
+		// Number of lines that were handled by TokenizeFallback so far.
+		std::size_t FallbackCount() const;
+
 		std::string &operator()(const std::string &text, std::string &out) const;
+
+		// Same, for text that is already decoded.
+		std::string &operator()(const string_type &text, std::string &out) const;
+
+		// Same, but the tokens one by one instead of joined by spaces. Combine
+		// with Options::no_escape to get them without XML escaping.
+		std::vector<std::string> &operator()(const std::string &text, std::vector<std::string> &tokens) const;
+
+		// Tokenizes many lines at once, running each step over all lines before
+		// moving on to the next. Same output as calling operator() for each line,
+		// but with less overhead per line. Lines that need to be split in
+		// windows, and all lines when a budget is set, are still done one by one.
+		void TokenizeBatch(const std::vector<std::string> &lines, std::vector<std::string> &out) const;
+
+		// Same, with the tokens of each line one by one.
+		void TokenizeBatch(const std::vector<std::string> &lines, std::vector<std::vector<std::string>> &out) const;
 	private:
-		void HandleNonbreakingPrefixes(string_type &text, string_type &out) const;
+		// Output is either a std::string with the tokens joined by spaces, or a
+		// std::vector<std::string> with one token per item. Both are taken
+		// straight from the decoded result.
+		template <typename Output> Output &Tokenize(const std::string &text, Output &out) const;
+
+		// Tokenizes text one window at a time, see SetWindowSize, with either
+		// RunSteps or TokenizeFallback.
+		template <typename Output> Output &TokenizeWindows(const std::string &text, Output &out, bool fallback) const;
+
+		template <typename Output> void TokenizeLines(const std::vector<std::string> &lines, std::vector<Output> &out) const;
+
+		// All the steps between decoding and encoding. Buffer is either a
+		// string_type or a LineBatch. Result ends up in text. Lookahead is the
+		// first character after text when it is a window of a longer line, or 0.
+		// See HandleNonbreakingPrefixes.
+		template <typename Buffer> void RunSteps(Buffer &text, Buffer &tmp, char_type lookahead) const;
+
+		// Linear time fallback: collapses whitespace and separates every
+		// character that is not a letter or a digit into its own token.
+		// Escaping still applies. Result ends up in text.
+		void TokenizeFallback(string_type &text, string_type &tmp) const;
+
+		void HandleNonbreakingPrefixes(string_type &text, string_type &out, char_type lookahead) const;
+
+		// Batches only hold whole lines, so there is nothing to look ahead at.
+		void HandleNonbreakingPrefixes(LineBatch &text, LineBatch &out, char_type) const;
+
+		// Appends the result for [begin, end) to out. A token ending with a
+		// period looks at the next one, or at lookahead if it is the last one.
+		// Without a lookahead (0), the last token is always split.
+		void HandleNonbreakingPrefixes(string_type::const_iterator begin, string_type::const_iterator end, string_type &out, char_type lookahead) const;
 
 		Options options_;
+		InvalidUTF8 invalid_utf8_;
+		std::size_t window_size_;
+		std::size_t max_steps_;
+		std::chrono::microseconds max_time_;
+		mutable std::atomic<std::size_t> fallback_count_;
 		std::string language_;
 		NonbreakingPrefixSet const &prefix_set_;
-		std::function<void(string_type &, string_type &)> pad_nonalpha_op_;
-		std::function<void(string_type &, string_type &)> apostrophe_op_;
+		AnyOp pad_nonalpha_op_;
+		AnyOp apostrophe_op_;
 };
 
 constexpr Tokenizer::Options operator|(Tokenizer::Options x, Tokenizer::Options y) {
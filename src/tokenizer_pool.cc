@@ -0,0 +1,63 @@
+#include "tokenizer_pool.hh"
+
+namespace {
+
+// Key of the tokenizer shared by all languages without rules or nonbreaking
+// prefixes of their own, "undetermined" in ISO 639.
+const std::string GENERIC_LANGUAGE("und");
+
+} // anonymous namespace
+
+namespace moses { namespace tokenizer {
+
+TokenizerPool::TokenizerPool(Factory factory, std::string default_language)
+: factory_(std::move(factory)),
+  default_language_(std::move(default_language)),
+  tokenizers_(nullptr) {
+	maps_.emplace_back(new Map());
+	tokenizers_ = maps_.back().get();
+}
+
+Tokenizer const &TokenizerPool::Get(std::string const &language) {
+	Map const *tokenizers = tokenizers_.load(std::memory_order_acquire);
+	auto it = tokenizers->find(language);
+	if (it != tokenizers->end())
+		return *it->second;
+
+	if (language.empty() && !default_language_.empty())
+		return Get(default_language_);
+
+	// Junk in a language column would otherwise get a tokenizer per distinct
+	// value, all of which would behave the same anyway. Not the default one
+	// though, which may have rules these languages don't.
+	if (language != GENERIC_LANGUAGE && !Tokenizer::IsKnownLanguage(language))
+		return Get(GENERIC_LANGUAGE);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// Another thread may have just added it
+	tokenizers = tokenizers_.load(std::memory_order_relaxed);
+	it = tokenizers->find(language);
+	if (it != tokenizers->end())
+		return *it->second;
+
+	owned_.push_back(factory_(language));
+
+	std::unique_ptr<Map> copy(new Map(*tokenizers));
+	copy->emplace(language, owned_.back().get());
+	tokenizers_.store(copy.get(), std::memory_order_release);
+	maps_.push_back(std::move(copy));
+
+	return *owned_.back();
+}
+
+std::size_t TokenizerPool::FallbackCount() {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	std::size_t count = 0;
+	for (auto const &tokenizer : owned_)
+		count += tokenizer->FallbackCount();
+	return count;
+}
+
+} } // end namespace
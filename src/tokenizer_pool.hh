@@ -0,0 +1,53 @@
+#ifndef TOKENIZER_POOL_HH
+#define TOKENIZER_POOL_HH
+
+#include "tokenizer.hh"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace moses { namespace tokenizer {
+
+/**
+ * One Tokenizer per language, created the first time that language is asked
+ * for. Languages that Tokenizer::IsKnownLanguage doesn't know all share one
+ * tokenizer, which works the same as one for any of them would. The empty
+ * language gets the one for default_language. All of them share the global
+ * NonbreakingPrefixSet instances. Safe to use from multiple threads.
+ */
+class TokenizerPool {
+public:
+	typedef std::function<std::unique_ptr<Tokenizer>(std::string const &language)> Factory;
+
+	TokenizerPool(Factory factory, std::string default_language);
+
+	// Doesn't lock once language has been asked for before.
+	Tokenizer const &Get(std::string const &language);
+
+	// Sum of Tokenizer::FallbackCount() of all tokenizers created so far.
+	std::size_t FallbackCount();
+
+private:
+	typedef std::unordered_map<std::string, Tokenizer const *> Map;
+
+	Factory factory_;
+	std::string default_language_;
+
+	// Get reads the current map without a lock. Adding a language publishes a
+	// copy with the language added. Older copies stay until the pool goes, as
+	// other threads may still be reading them.
+	std::atomic<Map const *> tokenizers_;
+
+	// Guards the members below
+	std::mutex mutex_;
+	std::vector<std::unique_ptr<Map const>> maps_;
+	std::vector<std::unique_ptr<Tokenizer>> owned_;
+};
+
+} } // end namespace
+
+#endif
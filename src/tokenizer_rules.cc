@@ -0,0 +1,82 @@
+#include "tokenizer_rules.hh"
+
+namespace moses { namespace tokenizer {
+
+std::vector<ReplaceOp> FiSvPadNonAlphanumericRules() {
+	return {
+		// in Finnish and Swedish, the colon can be used inside words as an apostrophe-like character:
+		// USA:n, 20:een, EU:ssa, USA:s, S:t
+		Replace(R"(([^[:alnum:]\s\.:'`,-]))", " $1 "),
+		// if a colon is not immediately followed by lower-case characters, separate it out anyway
+		Replace(R"((:)(?=$|[^[:Ll:]]))", " $1 ")
+	};
+}
+
+std::vector<ReplaceOp> CaPadNonAlphanumericRules() {
+	return {
+		// in Catalan, the middle dot can be used inside words: il�lusio
+		Replace(R"(([^[:alnum:]\s\.·'`,-]))", " $1 "),
+		// if a middot is not immediately followed by lower-case characters, separate it out anyway
+		Replace(R"((·)(?=$|[^[:Ll:]]))", " $1 ")
+	};
+}
+
+std::vector<ReplaceOp> SeparateCommaInNumbersRules() {
+	return {
+		// separate out "," except if within numbers (5,300)
+	   // previous "global" application skips some:  A,B,C,D,E > A , B,C , D,E
+	   // first application uses up B so rule can't see B,C
+	   // two-step version here may create extra spaces but these are removed later
+	   // will also space digit,letter or letter,digit forms (redundant with next section)
+		Replace("([^[:Number:]])[,]", "$1 , "),
+		Replace("[,]([^[:Number:]])", " , $1"),
+		// Separate "," after a number if it's the end of a sentence
+		Replace("([[:Number:]])[,]$", "$1 , ")
+	};
+}
+
+std::vector<ReplaceOp> EnSpecificApostropheRules() {
+	return {
+		// Split contractions right
+		Replace("([^[:alpha:]])[']([^[:alpha:]])", "$1 ' $2"),
+		Replace("([^[:alpha:][:Number:]])[']([[:alpha:]])", "$1 ' $2"),
+		Replace("([[:alpha:]])[']([^[:alpha:]])", "$1 ' $2"),
+		Replace("([[:alpha:]])[']([[:alpha:]])", "$1 '$2"),
+		// Special case for "1990's"
+		Replace("([[:Number:]])[']([s])", "$1 '$2")
+	};
+}
+
+std::vector<ReplaceOp> FrItGaCaSpecificApostropheRules() {
+	return {
+		// Split contractions left
+		Replace("([^[:alpha:]])[']([^[:alpha:]])", "$1 ' $2"),
+	  Replace("([^[:alpha:]])[']([[:alpha:]])", "$1 ' $2"),
+	  Replace("([[:alpha:]])[']([^[:alpha:]])", "$1 ' $2"),
+	  Replace("([[:alpha:]])[']([[:alpha:]])", "$1' $2")
+	};
+}
+
+std::vector<ReplaceOp> SoSpecificApostropheRules() {
+	return {
+		// Don't split glottals
+		Replace("([^[:alpha:]])[']([^[:alpha:]])", "$1 ' $2"),
+	  Replace("([^[:alpha:]])[']([[:alpha:]])", "$1 ' $2"),
+	  Replace("([[:alpha:]])[']([^[:alpha:]])", "$1 ' $2")
+	};
+}
+
+std::vector<ReplaceOp> EscapeSpecialCharsRules() {
+	return {
+		Replace("&", "&amp;"),   // escape escape
+		Replace("\\|", "&#124;"),  // factor separator
+		Replace("<", "&lt;"),    // xml
+		Replace(">", "&gt;"),    // xml
+		Replace("'", "&apos;"),  // xml
+		Replace("\"", "&quot;"),  // xml
+		Replace("\\[", "&#91;"),   // syntax non-terminal
+		Replace("\\]", "&#93;")    // syntax non-terminal
+	};
+}
+
+} } // end namespace
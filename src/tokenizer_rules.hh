@@ -0,0 +1,33 @@
+#ifndef TOKENIZER_RULES_HH
+#define TOKENIZER_RULES_HH
+
+#include "regex.hh"
+#include <vector>
+
+namespace moses { namespace tokenizer {
+
+/**
+ * The rules of the Tokenizer steps that take more than one replace op, in the
+ * order the Perl tokenizer applies them. Whether a step does them in one pass
+ * (ReplaceOp's list constructor, see Fuse) or one after the other
+ * (ReplaceChainOp) is up to tokenizer.cc; tests/fuse_test.cc checks that
+ * choice against these same rules.
+ */
+
+std::vector<ReplaceOp> FiSvPadNonAlphanumericRules();
+
+std::vector<ReplaceOp> CaPadNonAlphanumericRules();
+
+std::vector<ReplaceOp> SeparateCommaInNumbersRules();
+
+std::vector<ReplaceOp> EnSpecificApostropheRules();
+
+std::vector<ReplaceOp> FrItGaCaSpecificApostropheRules();
+
+std::vector<ReplaceOp> SoSpecificApostropheRules();
+
+std::vector<ReplaceOp> EscapeSpecialCharsRules();
+
+} } // end namespace
+
+#endif
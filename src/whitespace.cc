@@ -0,0 +1,96 @@
+#include "whitespace.hh"
+#include <algorithm>
+#include <unicode/uchar.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+using moses::tokenizer::char_type;
+
+// Exactly the code points matched by [\s] in u32regex. For ASCII that is
+// \t \n \v \f \r, the information separators 0x1C-0x1F and the space.
+inline bool IsSpace(char_type chr) {
+	if (chr < 0x80)
+		return (chr >= 0x09 && chr <= 0x0D) || (chr >= 0x1C && chr <= 0x20);
+	else
+		return u_isspace(chr);
+}
+
+// Collapse runs of \s into a single space, drop the other control characters
+// and never write a space at the start of the output.
+inline void Step(char_type chr, char_type const *begin, char_type *&out, bool &in_space) {
+	if (IsSpace(chr)) {
+		if (!in_space && out != begin)
+			*out++ = ' ';
+		in_space = true;
+	} else {
+		if (chr > 0x1F)
+			*out++ = chr;
+		in_space = false;
+	}
+}
+
+} // anonymous namespace
+
+namespace moses { namespace tokenizer {
+
+void NormalizeWhitespace(string_type &text) {
+	text.resize(NormalizeWhitespace(text.data(), text.data() + text.size()) - text.data());
+}
+
+char_type *NormalizeWhitespace(char_type *const begin, char_type *const end) {
+	char_type *in = begin;
+	char_type *out = begin;
+	bool in_space = false; // whether the previous input character was \s
+
+#ifdef __SSE2__
+	// Fast path: blocks of four printable ASCII characters (0x21-0x7F) contain
+	// nothing to collapse or remove, so they are moved over as a whole.
+	const __m128i lower = _mm_set1_epi32(0x20);
+	const __m128i upper = _mm_set1_epi32(0x80);
+	while (end - in >= 4) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in));
+		__m128i plain = _mm_and_si128(_mm_cmpgt_epi32(block, lower), _mm_cmplt_epi32(block, upper));
+		if (_mm_movemask_epi8(plain) == 0xFFFF) {
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out), block);
+			in += 4;
+			out += 4;
+			in_space = false;
+			continue;
+		}
+
+		// Slow path for just this block
+		for (char_type *block_end = in + 4; in != block_end; ++in)
+			Step(*in, begin, out, in_space);
+	}
+#endif
+
+	for (; in != end; ++in)
+		Step(*in, begin, out, in_space);
+
+	// Trailing spaces (leading ones were never written)
+	while (out != begin && *(out - 1) == ' ')
+		--out;
+
+	return out;
+}
+
+void NormalizeWhitespace(LineBatch &batch) {
+	// Lines only ever shrink, so each can be normalized in place and then moved
+	// forward to where the previous line ended.
+	char_type *const text = batch.text.data();
+	char_type *out = text;
+	char_type *begin = text;
+	for (std::size_t line = 0; line < batch.size(); ++line) {
+		char_type *next = text + batch.offsets[line + 1];
+		out = std::copy(begin, NormalizeWhitespace(begin, next), out);
+		batch.offsets[line + 1] = out - text;
+		begin = next;
+	}
+	batch.text.resize(out - text);
+}
+
+} } // end namespace
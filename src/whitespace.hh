@@ -0,0 +1,25 @@
+#ifndef WHITESPACE_HH
+#define WHITESPACE_HH
+
+#include "regex.hh" // for string_type
+
+namespace moses { namespace tokenizer {
+
+/**
+ * Single pass equivalent of `s/[\s]+/ /g; s/[\x00-\x1F]//g;` followed by
+ * trimming spaces from both ends. `\s` follows the same Unicode definition as
+ * boost's u32regex (u_isspace). Note that control characters are removed
+ * after whitespace is collapsed, so "a \x01 b" becomes "a  b", just like it
+ * did with the two separate regular expressions.
+ */
+void NormalizeWhitespace(string_type &text);
+
+// Same, in place on [begin, end). Returns the new end.
+char_type *NormalizeWhitespace(char_type *begin, char_type *end);
+
+// Same, for each line of the batch.
+void NormalizeWhitespace(LineBatch &batch);
+
+} } // end namespace
+
+#endif
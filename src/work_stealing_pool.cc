@@ -0,0 +1,91 @@
+#include "work_stealing_pool.hh"
+
+namespace moses { namespace tokenizer {
+
+WorkStealingPool::WorkStealingPool(std::size_t threads)
+: next_queue_(0),
+  pending_(0),
+  stopping_(false) {
+	if (threads == 0)
+		threads = 1;
+
+	for (std::size_t i = 0; i < threads; ++i)
+		queues_.emplace_back(new Queue());
+
+	for (std::size_t i = 0; i < threads; ++i)
+		workers_.emplace_back(&WorkStealingPool::Run, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	{
+		std::lock_guard<std::mutex> lock(idle_mutex_);
+		stopping_ = true;
+	}
+	idle_.notify_all();
+
+	for (auto &worker : workers_)
+		worker.join();
+}
+
+void WorkStealingPool::Submit(Task task) {
+	Queue &queue = *queues_[next_queue_++ % queues_.size()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(idle_mutex_);
+		++pending_;
+	}
+	idle_.notify_one();
+}
+
+bool WorkStealingPool::Pop(std::size_t index, Task &task) {
+	Queue &queue = *queues_[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty())
+		return false;
+
+	// Own queue is worked through oldest first, which keeps the output of an
+	// ordered pipeline flowing.
+	task = std::move(queue.tasks.front());
+	queue.tasks.pop_front();
+	return true;
+}
+
+bool WorkStealingPool::Steal(std::size_t index, Task &task) {
+	for (std::size_t i = 1; i < queues_.size(); ++i) {
+		Queue &queue = *queues_[(index + i) % queues_.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty())
+			continue;
+
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		return true;
+	}
+	return false;
+}
+
+void WorkStealingPool::Run(std::size_t index) {
+	Task task;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(idle_mutex_);
+			idle_.wait(lock, [this] { return pending_ > 0 || stopping_; });
+			if (pending_ == 0) // and therefore stopping_
+				return;
+			--pending_;
+		}
+
+		// We claimed one of the pending tasks, so one of the queues holds at
+		// least one task nobody else will take from us.
+		while (!Pop(index, task) && !Steal(index, task))
+			std::this_thread::yield();
+
+		task();
+		task = nullptr;
+	}
+}
+
+} } // end namespace
@@ -0,0 +1,64 @@
+#ifndef WORK_STEALING_POOL_HH
+#define WORK_STEALING_POOL_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace moses { namespace tokenizer {
+
+/**
+ * Fixed size thread pool where every worker has its own task queue. Tasks are
+ * handed out round-robin, and a worker that runs out of work steals from the
+ * back of the other queues. A worker that drew a few expensive tasks does not
+ * hold up the rest of the run that way.
+ */
+class WorkStealingPool {
+public:
+	typedef std::function<void()> Task;
+
+	explicit WorkStealingPool(std::size_t threads);
+
+	// Runs all remaining tasks before returning.
+	~WorkStealingPool();
+
+	WorkStealingPool(WorkStealingPool const &) = delete;
+	WorkStealingPool &operator=(WorkStealingPool const &) = delete;
+
+	void Submit(Task task);
+
+	std::size_t Size() const {
+		return workers_.size();
+	}
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void Run(std::size_t index);
+
+	bool Pop(std::size_t index, Task &task);
+
+	bool Steal(std::size_t index, Task &task);
+
+	std::vector<std::unique_ptr<Queue>> queues_;
+	std::vector<std::thread> workers_;
+	std::atomic<std::size_t> next_queue_;
+
+	// Idle workers sleep on this until there's work or we shut down
+	std::mutex idle_mutex_;
+	std::condition_variable idle_;
+	std::size_t pending_;
+	bool stopping_;
+};
+
+} } // end namespace
+
+#endif
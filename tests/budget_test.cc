@@ -0,0 +1,107 @@
+#include "test.hh"
+#include "src/tokenizer.hh"
+#include <chrono>
+#include <string>
+#include <vector>
+
+using moses::tokenizer::Tokenizer;
+
+namespace {
+
+std::string Repeat(std::string const &text, std::size_t count) {
+	std::string out;
+	for (std::size_t i = 0; i < count; ++i)
+		out += text;
+	return out;
+}
+
+// Lines that take the regular expressions anywhere from seconds to minutes.
+// ReplaceMultidot takes a pass over the whole line for every dot in a row.
+std::vector<std::string> AdversarialLines() {
+	return {
+		Repeat(".", 20000),
+		Repeat(Repeat(".", 2000) + " ", 10),
+		Repeat("a" + Repeat(".", 1000) + "b", 15)
+	};
+}
+
+void TestTimeBudget() {
+	Tokenizer tokenizer("en");
+	tokenizer.SetBudget(0, std::chrono::milliseconds(20));
+
+	auto start = std::chrono::steady_clock::now();
+	std::string out;
+	for (std::string const &line : AdversarialLines())
+		tokenizer(line, out);
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	CHECK(elapsed < std::chrono::seconds(2));
+	CHECK_EQUAL(3u, tokenizer.FallbackCount());
+
+	// The fallback splits off every dot
+	tokenizer(Repeat(".", 20000), out);
+	CHECK_EQUAL(Repeat(". ", 19999) + ".", out);
+
+	// Ordinary lines stay well within the budget
+	tokenizer("Mr. Smith paid $5,300.00 for the car, didn't he?", out);
+	CHECK_EQUAL("Mr. Smith paid $ 5,300.00 for the car , didn &apos;t he ?", out);
+	CHECK_EQUAL(4u, tokenizer.FallbackCount());
+}
+
+void TestStepBudget() {
+	Tokenizer tokenizer("en");
+	tokenizer.SetBudget(100, std::chrono::microseconds(0));
+
+	std::string out;
+	for (std::string const &line : AdversarialLines())
+		tokenizer(line, out);
+	CHECK_EQUAL(3u, tokenizer.FallbackCount());
+
+	// Steps count the passes over the line, not the tokens in it: per-token
+	// checks in HandleNonbreakingPrefixes are searches, which are free.
+	tokenizer.SetBudget(20, std::chrono::microseconds(0));
+	tokenizer(Repeat("word. Next ", 30) + "word.", out);
+	tokenizer(Repeat("Mr. Smith, ", 500), out);
+	CHECK_EQUAL(3u, tokenizer.FallbackCount());
+}
+
+// A line split into windows gets one budget for all of them, and counts as
+// one line when it runs out.
+void TestWindowedBudget() {
+	Tokenizer tokenizer("en");
+	tokenizer.SetWindowSize(300);
+
+	std::vector<std::string> lines(3, Repeat("This is a test. ", 200));
+	std::vector<std::string> expected(lines.size());
+	for (std::size_t i = 0; i < lines.size(); ++i)
+		tokenizer(lines[i], expected[i]);
+
+	tokenizer.SetBudget(5, std::chrono::microseconds(0));
+	std::string out;
+	for (std::string const &line : lines) {
+		tokenizer(line, out);
+		CHECK_EQUAL(Repeat("This is a test . ", 199) + "This is a test .", out);
+	}
+	CHECK_EQUAL(3u, tokenizer.FallbackCount());
+
+	// Plenty for one window, not for the eleven this line takes
+	tokenizer.SetBudget(100, std::chrono::microseconds(0));
+	tokenizer(lines[0], out);
+	CHECK_EQUAL(4u, tokenizer.FallbackCount());
+
+	tokenizer.SetBudget(1000, std::chrono::microseconds(0));
+	for (std::size_t i = 0; i < lines.size(); ++i) {
+		tokenizer(lines[i], out);
+		CHECK_EQUAL(expected[i], out);
+	}
+	CHECK_EQUAL(4u, tokenizer.FallbackCount());
+}
+
+} // anonymous namespace
+
+int main() {
+	TestTimeBudget();
+	TestStepBudget();
+	TestWindowedBudget();
+	return moses::tokenizer::test::TestStatus();
+}
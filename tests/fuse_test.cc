@@ -0,0 +1,80 @@
+#include "test.hh"
+#include "src/regex.hh"
+#include "src/tokenizer_rules.hh"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace moses::tokenizer;
+
+/**
+ * Checks the choices in src/tokenizer.cc between fusing the rules of a step
+ * into one pass and chaining them, using the rules from tokenizer_rules.hh it
+ * builds them from. The fused ones give the same output as the chain on any
+ * input, the others are shown an input where fusing them would go wrong.
+ */
+
+namespace {
+
+std::string Apply(AnyOp const &op, std::string const &text) {
+	string_type in(StrToUChar(text)), out;
+	op(in, out);
+	std::string str;
+	UCharToStr(out, str);
+	return str;
+}
+
+// Lots of short strings made of the characters the rules care about
+void CheckSameOutput(char const *name, std::vector<ReplaceOp> const &rules) {
+	ReplaceChainOp chain(rules);
+	ReplaceOp fused(rules);
+
+	std::vector<char_type> const characters{
+		'a', 'b', 's', 'A', '1', '2', ' ', '\t', ':', '\'', ',', '.', '-', '(', '!',
+		'&', '|', '<', '>', '"', '[', ']', '`', 0xB7 /* · */, 0xE9 /* é */,
+		0x2167 /* Ⅷ */, 'D', 'O', 'T', 'M', 'U', 'L', 'I'
+	};
+
+	std::mt19937 random(1);
+	string_type text, chain_out, fused_out;
+	for (std::size_t i = 0; i < 100000; ++i) {
+		text.resize(random() % 12);
+		for (char_type &chr : text)
+			chr = characters[random() % characters.size()];
+
+		string_type chain_in(text), fused_in(text);
+		chain(chain_in, chain_out);
+		fused(fused_in, fused_out);
+		if (chain_out != fused_out) {
+			std::string str;
+			UCharToStr(text, str);
+			CHECK_EQUAL(name + Apply(chain, str), name + Apply(fused, str));
+			return;
+		}
+	}
+}
+
+void CheckDifferentOutput(char const *name, std::vector<ReplaceOp> const &rules, std::string const &text) {
+	if (Apply(ReplaceChainOp(rules), text) == Apply(ReplaceOp(rules), text))
+		moses::tokenizer::test::Fail(__FILE__, __LINE__, std::string(name) + " gives the same output fused for [" + text + "]");
+}
+
+} // anonymous namespace
+
+int main() {
+	CheckSameOutput("FiSv: ", FiSvPadNonAlphanumericRules());
+	CheckSameOutput("Ca: ", CaPadNonAlphanumericRules());
+	CheckSameOutput("Escape: ", EscapeSpecialCharsRules());
+
+	// The second rule matches the ", " the first one produces, and B can't be
+	// both after the first comma and before the next.
+	CheckDifferentOutput("SeparateCommaInNumbers", SeparateCommaInNumbersRules(), "A,B,C");
+
+	// The apostrophe rules consume the characters around an apostrophe, which
+	// hides them from the match on the next one.
+	CheckDifferentOutput("EnSpecificApostrophe", EnSpecificApostropheRules(), "a''b");
+	CheckDifferentOutput("FrItGaCaSpecificApostrophe", FrItGaCaSpecificApostropheRules(), "a''b");
+	CheckDifferentOutput("SoSpecificApostrophe", SoSpecificApostropheRules(), "a''b");
+
+	return moses::tokenizer::test::TestStatus();
+}
@@ -0,0 +1,83 @@
+#include "test.hh"
+#include "src/incremental_tokenizer.hh"
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace moses::tokenizer;
+
+namespace {
+
+// Bits of text that are hard to cut around: prefixes, periods, apostrophes,
+// numbers, whitespace, other scripts and broken UTF-8.
+std::vector<std::string> const PIECES{
+	" ", "  ", "\t", "a", "Z", "9", "x.Y.", "Mr.", "Mr. Smith", "No. 5", ".", "..", "...",
+	",", "5,300", "3.5", "A. ", "'", "'s", " .' ", "l'homme", "isn't", "-", "well-known",
+	"\"", "(", ")", "&", "|", "<b>", "é", "мир", " Жж ", "日本語", "😀", "\xc3", "\xd0",
+	"U.S.A.", "e.g. the", "Hello", "world", "The dog.", "St. ", "p.m. ", "?", "!",
+};
+
+std::string RandomText(std::mt19937 &random, std::size_t pieces) {
+	std::string text;
+	for (std::size_t i = 0; i < pieces; ++i) {
+		text += PIECES[random() % PIECES.size()];
+		if (random() % 2)
+			text += ' ';
+	}
+	return text;
+}
+
+// Random edits over random text: after each one the output and token offsets
+// have to be those of tokenizing the whole text again.
+void TestRandomEdits(Tokenizer const &tokenizer, std::mt19937 &random) {
+	std::string full;
+	std::vector<std::size_t> offsets;
+	for (std::size_t round = 0; round < 15; ++round) {
+		IncrementalTokenizer incremental(tokenizer, 1 + random() % 64);
+		incremental.Reset(RandomText(random, random() % 100));
+
+		for (std::size_t edit = 0; edit < 100; ++edit) {
+			std::size_t size = incremental.Text().size();
+			std::size_t offset = random() % (size + 1);
+			std::size_t deleted = random() % 3 == 0 ? 0 : std::min<std::size_t>(size - offset, random() % 6);
+			std::string inserted = RandomText(random, random() % 4);
+			incremental.Edit(offset, deleted, inserted);
+
+			tokenizer(incremental.Text(), full);
+			offsets.clear();
+			for (std::size_t i = 0; i < full.size(); ++i)
+				if (full[i] != ' ' && (i == 0 || full[i - 1] == ' '))
+					offsets.push_back(i);
+
+			CHECK_EQUAL(full, incremental.Output());
+			CHECK(offsets == incremental.TokenOffsets());
+			if (moses::tokenizer::test::Failures() > 0)
+				return;
+		}
+	}
+}
+
+} // anonymous namespace
+
+int main() {
+	std::mt19937 random(38);
+	for (char const *language : {"en", "fr", "fi"}) {
+		TestRandomEdits(Tokenizer(language), random);
+		TestRandomEdits(Tokenizer(language, Tokenizer::Options::aggressive), random);
+	}
+
+	Tokenizer english("en");
+	IncrementalTokenizer incremental(english, 8);
+	incremental.Reset("Mr. Smith");
+	bool thrown = false;
+	try {
+		incremental.Edit(5, 10, "");
+	} catch (std::out_of_range const &) {
+		thrown = true;
+	}
+	CHECK(thrown);
+	CHECK_EQUAL("Mr. Smith", incremental.Output());
+
+	return moses::tokenizer::test::TestStatus();
+}
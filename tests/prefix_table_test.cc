@@ -0,0 +1,136 @@
+#include "test.hh"
+#include "src/nonbreaking_prefix_set.hh"
+#include "src/prefix_table.hh"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+using namespace moses::tokenizer;
+
+namespace {
+
+// Written next to the test binary
+const std::string PATH("prefix_table_test.bin");
+
+void WriteFile(std::string const &contents) {
+	std::ofstream out(PATH, std::ios::binary);
+	out << contents;
+}
+
+bool Throws(std::string const &path) {
+	try {
+		PrefixTable table(path);
+	} catch (std::runtime_error const &) {
+		return true;
+	}
+	return false;
+}
+
+// A table written by Write maps back with the same flags for every prefix,
+// with enough of them that buckets collide.
+void TestRoundTrip() {
+	std::unordered_set<string_type> text, numeric;
+	for (std::size_t i = 0; i < 1000; ++i)
+		text.insert(StrToUChar("p" + std::to_string(i)));
+	text.insert(StrToUChar("Mr"));
+	text.insert(StrToUChar("Jäk"));
+	text.insert(StrToUChar("日本"));
+	numeric.insert(StrToUChar("No"));
+	numeric.insert(StrToUChar("Art"));
+	numeric.insert(StrToUChar("Mr")); // in both
+
+	{
+		std::ofstream out(PATH, std::ios::binary);
+		PrefixTable::Write(out, text, numeric);
+	}
+
+	PrefixTable table(PATH);
+	for (string_type const &prefix : text)
+		CHECK(table.Find(prefix) & PrefixTable::TEXT);
+	CHECK_EQUAL(uint32_t(PrefixTable::TEXT), table.Find(StrToUChar("p123")));
+	CHECK_EQUAL(uint32_t(PrefixTable::NUMERIC), table.Find(StrToUChar("No")));
+	CHECK_EQUAL(uint32_t(PrefixTable::TEXT | PrefixTable::NUMERIC), table.Find(StrToUChar("Mr")));
+
+	// Not there, also when they share a start with one that is
+	CHECK_EQUAL(0u, table.Find(StrToUChar("p1000")));
+	CHECK_EQUAL(0u, table.Find(StrToUChar("M")));
+	CHECK_EQUAL(0u, table.Find(StrToUChar("mr")));
+	CHECK_EQUAL(0u, table.Find(StrToUChar("Jak")));
+	CHECK_EQUAL(0u, table.Find(string_type()));
+}
+
+void TestEmpty() {
+	{
+		std::ofstream out(PATH, std::ios::binary);
+		PrefixTable::Write(out, {}, {});
+	}
+
+	PrefixTable table(PATH);
+	CHECK_EQUAL(0u, table.Find(StrToUChar("Mr")));
+}
+
+// A compiled set answers the same as the text one it came from.
+void TestCompile() {
+	NonbreakingPrefixSet text_set(
+		"# comment\n"
+		"\n"
+		"Mr\n"
+		"Dr\n"
+		"No #NUMERIC_ONLY#\n"
+		"Art #NUMERIC_ONLY#\n");
+
+	{
+		std::ofstream out(PATH, std::ios::binary);
+		text_set.Compile(out);
+	}
+
+	NonbreakingPrefixSet table_set(std::make_shared<PrefixTable const>(PATH));
+	for (char const *token : {"Mr", "Dr", "No", "Art", "Mrs", "# comment", "No #NUMERIC_ONLY#", ""}) {
+		CHECK_EQUAL(text_set.IsNonbreakingPrefix(StrToUChar(token)), table_set.IsNonbreakingPrefix(StrToUChar(token)));
+		CHECK_EQUAL(text_set.IsNumericNonbreakingPrefix(StrToUChar(token)), table_set.IsNumericNonbreakingPrefix(StrToUChar(token)));
+	}
+	CHECK(table_set.IsNonbreakingPrefix(StrToUChar("Mr")));
+	CHECK(!table_set.IsNonbreakingPrefix(StrToUChar("No")));
+	CHECK(table_set.IsNumericNonbreakingPrefix(StrToUChar("No")));
+}
+
+// Files that aren't tables are refused instead of read out of bounds.
+void TestBadFiles() {
+	CHECK(Throws("prefix_table_test.missing"));
+
+	WriteFile("");
+	CHECK(Throws(PATH));
+
+	WriteFile("Mr\nDr\nNo #NUMERIC_ONLY#\n");
+	CHECK(Throws(PATH));
+
+	// A valid table cut short
+	std::string table;
+	{
+		std::ofstream out(PATH, std::ios::binary);
+		PrefixTable::Write(out, {StrToUChar("Mr")}, {});
+	}
+	{
+		std::ifstream in(PATH, std::ios::binary);
+		table.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+	for (std::size_t size : {std::size_t(4), std::size_t(16), table.size() - 1}) {
+		WriteFile(table.substr(0, size));
+		CHECK(Throws(PATH));
+	}
+}
+
+} // anonymous namespace
+
+int main() {
+	TestRoundTrip();
+	TestEmpty();
+	TestCompile();
+	TestBadFiles();
+	std::remove(PATH.c_str());
+	return moses::tokenizer::test::TestStatus();
+}
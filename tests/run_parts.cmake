@@ -0,0 +1,21 @@
+# Helper for add_parts_test, see CMakeLists.txt.
+separate_arguments(ARGS)
+string(REPLACE "," ";" PARTS "${PARTS}")
+
+file(WRITE ${OUTPUT} "")
+foreach(PART ${PARTS})
+    execute_process(COMMAND ${TOKENIZER} ${ARGS} ${OPTION} ${PART} ${INPUT}
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE errors
+        RESULT_VARIABLE status)
+    if (NOT status STREQUAL "0")
+        message(FATAL_ERROR "tokenizer ${OPTION} ${PART} exited with status ${status}:\n${errors}")
+    endif ()
+    file(APPEND ${OUTPUT} "${output}")
+endforeach()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED}
+    RESULT_VARIABLE different)
+if (different)
+    message(FATAL_ERROR "concatenated output in ${OUTPUT} differs from ${EXPECTED}")
+endif ()
@@ -0,0 +1,47 @@
+# Helper for add_prefix_dir_test, see CMakeLists.txt. Fills DIR with the
+# custom prefix list for English in the way CASE says, then tokenizes INPUT
+# with MOSES_NONBREAKING_PREFIX_DIR set to it.
+#   bin      compiled with compile_prefixes
+#   text     the text file only
+#   bad_bin  the text file next to a .bin that isn't a table, which has to
+#            be reported and ignored
+#   none     only a list for another language, so the built-in one is used
+file(REMOVE_RECURSE ${DIR})
+file(MAKE_DIRECTORY ${DIR})
+
+if (CASE STREQUAL "bin")
+    execute_process(COMMAND ${COMPILE_PREFIXES} ${PREFIXES} ${DIR}/nonbreaking_prefix.en.bin
+        RESULT_VARIABLE status)
+    if (NOT status STREQUAL "0")
+        message(FATAL_ERROR "compile_prefixes exited with status ${status}")
+    endif ()
+elseif (CASE STREQUAL "text")
+    configure_file(${PREFIXES} ${DIR}/nonbreaking_prefix.en COPYONLY)
+elseif (CASE STREQUAL "bad_bin")
+    configure_file(${PREFIXES} ${DIR}/nonbreaking_prefix.en COPYONLY)
+    file(WRITE ${DIR}/nonbreaking_prefix.en.bin "not a table")
+elseif (CASE STREQUAL "none")
+    configure_file(${PREFIXES} ${DIR}/nonbreaking_prefix.fr COPYONLY)
+else ()
+    message(FATAL_ERROR "unknown case ${CASE}")
+endif ()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E env MOSES_NONBREAKING_PREFIX_DIR=${DIR} ${TOKENIZER} -l en
+    INPUT_FILE ${INPUT}
+    OUTPUT_FILE ${OUTPUT}
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE status)
+
+if (NOT status STREQUAL "0")
+    message(FATAL_ERROR "tokenizer exited with status ${status}:\n${errors}")
+endif ()
+
+if (CASE STREQUAL "bad_bin" AND NOT errors MATCHES "Ignoring .*nonbreaking_prefix.en.bin")
+    message(FATAL_ERROR "expected a warning about the bad .bin, got:\n${errors}")
+endif ()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED}
+    RESULT_VARIABLE different)
+if (different)
+    message(FATAL_ERROR "output in ${OUTPUT} differs from ${EXPECTED}")
+endif ()
@@ -0,0 +1,25 @@
+# Helper for add_tokenizer_test, see CMakeLists.txt.
+separate_arguments(ARGS)
+
+execute_process(COMMAND ${TOKENIZER} ${ARGS}
+    INPUT_FILE ${INPUT}
+    OUTPUT_FILE ${OUTPUT}
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE status)
+
+if (EXPECTED STREQUAL "FAIL")
+    if (NOT status STREQUAL "1")
+        message(FATAL_ERROR "expected the tokenizer to exit with status 1, got: ${status}")
+    endif ()
+    return()
+endif ()
+
+if (NOT status STREQUAL "0")
+    message(FATAL_ERROR "tokenizer exited with status ${status}:\n${errors}")
+endif ()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED}
+    RESULT_VARIABLE different)
+if (different)
+    message(FATAL_ERROR "output in ${OUTPUT} differs from ${EXPECTED}")
+endif ()
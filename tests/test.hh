@@ -0,0 +1,49 @@
+#ifndef TESTS_TEST_HH
+#define TESTS_TEST_HH
+
+#include <iostream>
+#include <sstream>
+
+/**
+ * Just enough to write the tests in this directory without a test framework.
+ * CHECK and CHECK_EQUAL report a failure and carry on; main returns
+ * TestStatus() so ctest sees whether any of them failed.
+ */
+namespace moses { namespace tokenizer { namespace test {
+
+inline std::size_t &Failures() {
+	static std::size_t failures = 0;
+	return failures;
+}
+
+inline void Fail(char const *file, int line, std::string const &message) {
+	++Failures();
+	std::cerr << file << ":" << line << ": " << message << std::endl;
+}
+
+inline int TestStatus() {
+	if (Failures() > 0)
+		std::cerr << Failures() << " checks failed" << std::endl;
+	return Failures() > 0 ? 1 : 0;
+}
+
+} } } // end namespace
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+			moses::tokenizer::test::Fail(__FILE__, __LINE__, "check failed: " #condition); \
+	} while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+	do { \
+		auto const &expected_ = (expected); \
+		auto const &actual_ = (actual); \
+		if (!(expected_ == actual_)) { \
+			std::ostringstream message_; \
+			message_ << #actual " is [" << actual_ << "], expected [" << expected_ << "]"; \
+			moses::tokenizer::test::Fail(__FILE__, __LINE__, message_.str()); \
+		} \
+	} while (0)
+
+#endif
@@ -0,0 +1,117 @@
+#include "test.hh"
+#include "src/token_stream.hh"
+#include "src/tokenizer.hh"
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace moses::tokenizer;
+
+namespace {
+
+std::vector<std::string> const LINES{
+	"This is a test.",
+	"Mr. Smith paid $5,300.00 for the car, didn't he?",
+	"  leading and trailing whitespace\t ",
+	"",
+	"A&B <tag> \"quoted\" [brackets] | pipe",
+	"Dr. Jekyll's dog...and Mr.Hyde's cat.",
+	"Ünïcödé wörds, 日本語 and emoji 😀 too.",
+	"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa.bbb",
+};
+
+std::vector<std::string> Split(std::string const &tokenized) {
+	std::vector<std::string> tokens;
+	std::istringstream in(tokenized);
+	for (std::string token; in >> token;)
+		tokens.push_back(token);
+	return tokens;
+}
+
+// The tokens one by one are the same as the joined line split on spaces, for
+// lines in one window or many, and through the fallback.
+void TestTokens(Tokenizer &tokenizer) {
+	std::string tokenized;
+	std::vector<std::string> tokens;
+	for (std::string const &line : LINES) {
+		tokenizer(line, tokens);
+		CHECK(tokens == Split(tokenizer(line, tokenized)));
+	}
+
+	std::vector<std::string> joined;
+	std::vector<std::vector<std::string>> batch;
+	tokenizer.TokenizeBatch(LINES, joined);
+	tokenizer.TokenizeBatch(LINES, batch);
+	CHECK_EQUAL(LINES.size(), batch.size());
+	for (std::size_t i = 0; i < LINES.size(); ++i)
+		CHECK(batch[i] == Split(joined[i]));
+}
+
+// Records read back are the tokens that were written, whatever bytes they hold.
+void TestRoundTrip() {
+	std::vector<std::vector<std::string>> const records{
+		{"This", "is", "a", "test", "."},
+		{},
+		{"&", "|", "<", "\"", "'"},
+		{"", "empty", ""},
+		{std::string("nul\0byte", 8), "tab\there", "ünï", "😀"},
+		{std::string(70000, 'x')},
+	};
+
+	std::ostringstream out;
+	for (std::vector<std::string> const &tokens : records)
+		WriteTokens(out, tokens);
+
+	std::string encoded;
+	for (std::vector<std::string> const &tokens : records)
+		EncodeTokens(tokens, encoded);
+	CHECK(encoded == out.str());
+
+	std::istringstream in(encoded);
+	std::vector<std::string> tokens;
+	for (std::vector<std::string> const &expected : records) {
+		CHECK(ReadTokens(in, tokens));
+		CHECK(tokens == expected);
+	}
+	CHECK(!ReadTokens(in, tokens));
+
+	// Little-endian count and lengths
+	encoded.clear();
+	EncodeTokens({"ab"}, encoded);
+	CHECK(encoded == std::string("\x01\x00\x00\x00\x02\x00\x00\x00" "ab", 10));
+
+	// Every cut short of a whole record is an error
+	for (std::size_t size = 1; size < encoded.size(); ++size) {
+		std::istringstream truncated(encoded.substr(0, size));
+		bool thrown = false;
+		try {
+			ReadTokens(truncated, tokens);
+		} catch (std::runtime_error const &) {
+			thrown = true;
+		}
+		CHECK(thrown);
+	}
+}
+
+} // anonymous namespace
+
+int main() {
+	Tokenizer tokenizer("en", Tokenizer::Options::no_escape);
+	TestTokens(tokenizer);
+
+	tokenizer.SetWindowSize(8);
+	TestTokens(tokenizer);
+
+	tokenizer.SetWindowSize(0);
+	tokenizer.SetBudget(3, std::chrono::microseconds(0));
+	TestTokens(tokenizer);
+	CHECK(tokenizer.FallbackCount() > 0);
+
+	// Escaped tokens never contain spaces either
+	Tokenizer escaping("en");
+	TestTokens(escaping);
+
+	TestRoundTrip();
+	return moses::tokenizer::test::TestStatus();
+}
@@ -0,0 +1,57 @@
+#include "test.hh"
+#include "src/tokenizer_pool.hh"
+#include <string>
+#include <thread>
+#include <vector>
+
+using moses::tokenizer::Tokenizer;
+using moses::tokenizer::TokenizerPool;
+
+int main() {
+	std::size_t created = 0;
+	TokenizerPool pool([&created](std::string const &language) {
+		++created;
+		return std::unique_ptr<Tokenizer>(new Tokenizer(language));
+	}, "en");
+
+	Tokenizer const &en = pool.Get("en");
+	CHECK(&pool.Get("fr") != &en);
+	CHECK(&pool.Get("so") != &en);
+	CHECK(&pool.Get("fr") == &pool.Get("fr"));
+
+	// Empty languages get the default one
+	CHECK(&pool.Get("") == &en);
+
+	// Languages without rules of their own, junk too, share another one
+	Tokenizer const &generic = pool.Get("ko");
+	CHECK(&generic != &en);
+	CHECK(&pool.Get("xx-junk") == &generic);
+	CHECK(&pool.Get("<lang>") == &generic);
+	CHECK_EQUAL(4u, created);
+
+	// Which works like a tokenizer for any of them
+	std::string shared, own;
+	CHECK_EQUAL(Tokenizer("ko")("don't", own), generic("don't", shared));
+	CHECK(shared != en("don't", own));
+
+	// Many threads asking for the same few languages at once get the same
+	// tokenizers, each created once.
+	std::vector<std::string> const languages{"en", "fr", "fi", "de", "nl", "??", ""};
+	std::vector<std::vector<Tokenizer const *>> seen(8);
+	std::vector<std::thread> threads;
+	for (std::size_t i = 0; i < seen.size(); ++i) {
+		threads.emplace_back([&pool, &languages, &seen, i] {
+			for (std::size_t j = 0; j < 1000; ++j)
+				seen[i].push_back(&pool.Get(languages[(i + j) % languages.size()]));
+		});
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+
+	for (std::size_t i = 0; i < seen.size(); ++i)
+		for (std::size_t j = 0; j < seen[i].size(); ++j)
+			CHECK(seen[i][j] == &pool.Get(languages[(i + j) % languages.size()]));
+	CHECK_EQUAL(7u, created);
+
+	return moses::tokenizer::test::TestStatus();
+}
@@ -0,0 +1,109 @@
+#include "test.hh"
+#include "src/regex.hh"
+#include <iterator>
+#include <random>
+#include <string>
+
+using namespace moses::tokenizer;
+
+namespace {
+
+// Any code point but a surrogate, with all lengths equally likely
+char_type RandomCodePoint(std::mt19937 &random) {
+	switch (random() % 4) {
+		case 0:
+			return random() % 0x80;
+		case 1:
+			return 0x80 + random() % 0x780;
+		case 2: {
+			char_type chr;
+			do chr = 0x800 + random() % 0xF800; while (chr >= 0xD800 && chr <= 0xDFFF);
+			return chr;
+		}
+		default:
+			return 0x10000 + random() % 0x100000;
+	}
+}
+
+// Valid text encodes like boost does, and decodes back the same with either
+// policy.
+void TestValid() {
+	typedef boost::u32_to_u8_iterator<string_type::const_iterator> Encoder;
+
+	std::mt19937 random(7);
+	string_type text, decoded;
+	std::string expected, encoded;
+	for (std::size_t i = 0; i < 100000; ++i) {
+		text.resize(random() % 40);
+		for (char_type &chr : text)
+			chr = RandomCodePoint(random);
+
+		expected.clear();
+		std::copy(Encoder(text.begin()), Encoder(text.end()), std::back_inserter(expected));
+		UCharToStr(text, encoded);
+		CHECK(encoded == expected);
+
+		StrToUChar(encoded, decoded);
+		CHECK(decoded == text);
+
+		StrToUChar(encoded, decoded, InvalidUTF8::pass);
+		CHECK(decoded == text);
+	}
+}
+
+// Random bytes come back unchanged with InvalidUTF8::pass, and as valid code
+// points only with InvalidUTF8::replace.
+void TestRandomBytes() {
+	std::mt19937 random(7);
+	std::string bytes, encoded;
+	string_type decoded;
+	for (std::size_t i = 0; i < 100000; ++i) {
+		bytes.resize(random() % 40);
+		for (char &byte : bytes)
+			byte = random() % 3 == 0 ? random() % 0x80 : 0x80 + random() % 0x80;
+
+		StrToUChar(bytes, decoded, InvalidUTF8::pass);
+		UCharToStr(decoded, encoded);
+		CHECK(encoded == bytes);
+
+		StrToUChar(bytes, decoded);
+		for (char_type chr : decoded)
+			CHECK(chr < 0xD800 || chr > 0xDFFF);
+	}
+}
+
+// One U+FFFD per maximal subpart, as in table 3-8 of the Unicode standard,
+// which also catches overlong forms, surrogates and code points beyond U+10FFFF.
+void TestReplacement() {
+	string_type decoded;
+	std::string encoded;
+
+	StrToUChar("\x61\xF1\x80\x80\xE1\x80\xC2\x62\x80\x63\x80\xBF\x64", decoded);
+	UCharToStr(decoded, encoded);
+	CHECK_EQUAL("a\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD" "b\xEF\xBF\xBD" "c\xEF\xBF\xBD\xEF\xBF\xBD" "d", encoded);
+
+	StrToUChar("\xC0\xAF", decoded);
+	CHECK_EQUAL(2u, decoded.size());
+
+	StrToUChar("\xED\xA0\x80", decoded);
+	CHECK_EQUAL(3u, decoded.size());
+
+	StrToUChar("\xF4\x90\x80\x80", decoded);
+	CHECK_EQUAL(4u, decoded.size());
+
+	StrToUChar("\xF4\x8F\xBF\xBF", decoded);
+	CHECK(decoded == string_type{0x10FFFF});
+
+	// Lone surrogates that don't stand for a byte can't be encoded
+	UCharToStr(string_type{'a', 0xD800, 'b'}, encoded);
+	CHECK_EQUAL("a\xEF\xBF\xBD" "b", encoded);
+}
+
+} // anonymous namespace
+
+int main() {
+	TestValid();
+	TestRandomBytes();
+	TestReplacement();
+	return moses::tokenizer::test::TestStatus();
+}
@@ -0,0 +1,108 @@
+#include "test.hh"
+#include "src/tokenizer.hh"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using moses::tokenizer::Tokenizer;
+
+namespace {
+
+std::string Tokenize(Tokenizer &tokenizer, std::size_t window_size, std::string const &text) {
+	std::string out;
+	tokenizer.SetWindowSize(window_size);
+	tokenizer(text, out);
+	return out;
+}
+
+std::string WithoutSpaces(std::string text) {
+	text.erase(std::remove(text.begin(), text.end(), ' '), text.end());
+	return text;
+}
+
+std::string Repeat(std::string const &text, std::size_t count) {
+	std::string out;
+	for (std::size_t i = 0; i < count; ++i)
+		out += text;
+	return out;
+}
+
+void TestSafeCut() {
+	CHECK(Tokenizer::IsSafeCut("a b", 1));
+	CHECK(Tokenizer::IsSafeCut("a\tb", 1));
+	CHECK(Tokenizer::IsSafeCut("привет мир", 12));
+	CHECK(Tokenizer::IsSafeCut("λ ٣", 2));
+	CHECK(!Tokenizer::IsSafeCut("a  b", 1));
+	CHECK(!Tokenizer::IsSafeCut("a. b", 2));
+	CHECK(!Tokenizer::IsSafeCut("a 'b", 1));
+	CHECK(!Tokenizer::IsSafeCut("\xd0 b", 1));
+	CHECK(!Tokenizer::IsSafeCut(" b", 0));
+	CHECK(!Tokenizer::IsSafeCut("a ", 1));
+}
+
+// Pieces that the rules treat specially, so windows get cut next to them.
+char const *const PIECES[] = {
+	"'", ",", ".", "..", "...", "Mr.", "No.", "e.g.", "a", "x", "5", "12",
+	"(", ")", "&", "<", "|", "\"", "?", " ", "\t", "\x01", "\x1c", ":", "·",
+	"-", "`", "’", "«", "DOT", "MULTI", "DOTMULTI", "é", "Ж", "日本", "٣",
+	"S:t", "l", "s", "t", "\xcc\x81"
+};
+
+// Windows of a line cut only where it doesn't change the outcome give the
+// same output as the whole line. The lines are chunks of random pieces that
+// are never more than a window apart from a safe cut, so no window needs to
+// be cut at an arbitrary point.
+void TestRandomLines(std::string const &language, Tokenizer::Options options) {
+	Tokenizer tokenizer(language, options);
+	std::mt19937 random(42);
+	std::size_t const piece_count = sizeof(PIECES) / sizeof(PIECES[0]);
+
+	for (std::size_t i = 0; i < 2000; ++i) {
+		std::string line;
+		for (std::size_t chunks = 1 + random() % 20; chunks > 0; --chunks) {
+			for (std::size_t pieces = random() % 4; pieces > 0; --pieces)
+				line += PIECES[random() % piece_count];
+			line += " z z ";
+		}
+
+		std::string expected = Tokenize(tokenizer, 0, line);
+		for (std::size_t window_size : {32, 40, 57})
+			CHECK_EQUAL(expected, Tokenize(tokenizer, window_size, line));
+	}
+}
+
+// Long lines without a single ASCII letter get cut too, and the same goes for
+// the space-free blobs found in crawled text.
+void TestLongLines() {
+	Tokenizer tokenizer("en");
+
+	std::string cyrillic = Repeat("Слово за слово. Ещё, «одно» слово... ", 2000);
+	CHECK_EQUAL(Tokenize(tokenizer, 0, cyrillic), Tokenize(tokenizer, 100, cyrillic));
+
+	std::string base64 = Repeat("QUJDREVGR0hJSktM+TU5PUFFSU1RVVldY/WVphYmNkZWZnaGlq=", 1000);
+	CHECK_EQUAL(Tokenize(tokenizer, 0, base64), Tokenize(tokenizer, 100, base64));
+
+	std::string letters = Repeat("abcdefghijklmnopqrstuvwxyz0123456789", 1000);
+	CHECK_EQUAL(Tokenize(tokenizer, 0, letters), Tokenize(tokenizer, 100, letters));
+
+	// Without any place to cut exactly, a window may split or join a token
+	// around its end, but nothing gets lost.
+	std::string dotted = Repeat("a.b.c.d.e.f.g.h.", 1000);
+	CHECK_EQUAL(WithoutSpaces(Tokenize(tokenizer, 0, dotted)), WithoutSpaces(Tokenize(tokenizer, 100, dotted)));
+}
+
+} // anonymous namespace
+
+int main() {
+	TestSafeCut();
+
+	for (std::string language : {"en", "fr", "fi", "ca", "so", "de"}) {
+		TestRandomLines(language, Tokenizer::Options::none);
+		TestRandomLines(language, Tokenizer::Options::aggressive | Tokenizer::Options::no_escape);
+	}
+
+	TestLongLines();
+
+	return moses::tokenizer::test::TestStatus();
+}
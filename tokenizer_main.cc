@@ -1,36 +1,345 @@
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <future>
+#include <memory>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <sstream>
 #include "src/tokenizer.hh"
+#include "src/tokenizer_pool.hh"
+#include "src/work_stealing_pool.hh"
+#include "src/bounded_queue.hh"
+#include "src/mapped_file.hh"
+#include "src/token_stream.hh"
+#include "src/sentence_splitter.hh"
 #include <boost/regex/icu.hpp>
+#include <unicode/uchar.h>
 
 using moses::tokenizer::Tokenizer;
+using moses::tokenizer::TokenizerPool;
+using moses::tokenizer::WorkStealingPool;
+using moses::tokenizer::BoundedQueue;
+using moses::tokenizer::MappedFile;
+using moses::tokenizer::EncodeTokens;
+using moses::tokenizer::SentenceSplitter;
+using moses::tokenizer::InvalidUTF8;
+using moses::tokenizer::StrToUChar;
+using moses::tokenizer::string_type;
+using moses::tokenizer::char_type;
 
 int usage(char *progname) {
-	std::cerr << "Usage: " << progname << " -l language\n"
+	std::cerr << "Usage: " << progname << " -l language [options] [file ...]\n"
 	             "\n"
-	             "Any line in stdin will be tokenized to stdout.\n"
+	             "Any line in stdin (or the files given) will be tokenized to stdout.\n"
+	             "\n"
+	             "Options:\n"
+	             "  -threads N   tokenize with N threads\n"
+	             "  -lines N     lines per unit of work when using threads (default 2000)\n"
+	             "  -o FILE      write to FILE instead of stdout\n"
+	             "  -o-dir DIR   write each input file to DIR/basename instead\n"
+	             "  -window N    tokenize lines longer than N bytes in parts (default 65536,\n"
+	             "               0 to disable)\n"
+	             "  -budget-steps N\n"
+	             "               max number of regex replace passes per line, about 15\n"
+	             "               for a line that fits in one -window\n"
+	             "  -budget-us N max microseconds per line\n"
+	             "               lines over budget are split on every non-alphanumeric\n"
+	             "               character instead, and counted on stderr\n"
+	             "  -tsv-lang N  input is tab separated, column N holds the language.\n"
+	             "               Empty languages are tokenized as -l. Languages without\n"
+	             "               rules of their own all get the generic rules that -l\n"
+	             "               would give them.\n"
+	             "  -tsv-text N[,M...]\n"
+	             "               columns to tokenize (default 2); other columns are\n"
+	             "               copied as-is. Columns count from 1.\n"
+	             "  -shard I/N   only tokenize the lines that start in the I-th of N equal\n"
+	             "               parts of the input file (I counts from 0)\n"
+	             "  -byte-range START:END\n"
+	             "               only tokenize the lines that start in bytes [START, END) of\n"
+	             "               the input file. END may be left out.\n"
+	             "               Concatenating the output of all parts gives the same output\n"
+	             "               as tokenizing the whole file.\n"
+	             "  -binary      write each line as a uint32 token count followed by a uint32\n"
+	             "               byte length and the UTF-8 bytes of each token, all\n"
+	             "               little-endian. Implies -no-escape.\n"
+	             "  -split-sentences\n"
+	             "               split paragraphs into sentences first, like\n"
+	             "               split-sentences.perl, and write one tokenized sentence\n"
+	             "               per line. Paragraphs end at blank lines, which are\n"
+	             "               written as <P>, and at lines that are just a tag.\n"
+	             "               Not available for zh, yue and ja.\n"
+	             "  -invalid replace|pass\n"
+	             "               replace invalid UTF-8 with U+FFFD (default), or pass the\n"
+	             "               bytes through unchanged. Either way they are tokenized\n"
+	             "               like symbols, so they are split off as tokens of their own.\n"
 	          << std::endl;
 	return 1;
 }
 
-void ProcessStream(Tokenizer const &tokenizer, std::istream &in, std::ostream &out) {
+// Turns an input line into an output line. Either a Tokenizer or TokenizeColumns.
+typedef std::function<std::string &(std::string const &text, std::string &out)> LineProcessor;
+
+// Same, for many lines at once.
+typedef std::function<void(std::vector<std::string> const &lines, std::vector<std::string> &out)> BatchProcessor;
+
+// Output of the processor is followed by line_end, which is empty for
+// binary output.
+void ProcessStream(LineProcessor const &tokenizer, std::istream &in, std::ostream &out, std::string const &line_end) {
 	std::string text, tokenized;
 	while (std::getline(in, text))
-		out << tokenizer(text, tokenized) << std::endl;
+		out << tokenizer(text, tokenized) << line_end << std::flush;
 }
 
-int ProcessFiles(Tokenizer const &tokenizer, int argc, char *argv[], std::ostream &out) {
+typedef std::function<std::shared_ptr<std::istream>(std::string const &filename)> InputFactory;
+
+int ProcessFiles(LineProcessor const &tokenizer, int argc, char *argv[], InputFactory const &open_input, std::ostream &out, std::string const &line_end) {
+	int status = 0;
 	int i = 0;
 	do {
-			if (i == argc || argv[i] == std::string("-"))
-				ProcessStream(tokenizer, std::cin, out);
-			else {
-				std::ifstream in(argv[i]);
-				ProcessStream(tokenizer, in, out);
+			std::shared_ptr<std::istream> in(open_input(i == argc ? "-" : argv[i]));
+			if (in)
+				ProcessStream(tokenizer, *in, out, line_end);
+			else
+				status = 1;
+		} while (++i < argc);
+
+	return status;
+}
+
+// Lines of one input file, and where their tokenized output needs to go.
+struct Chunk {
+	std::future<std::string> text;
+	std::shared_ptr<std::ostream> out;
+};
+
+typedef std::function<std::shared_ptr<std::ostream>(std::string const &filename)> OutputFactory;
+
+/**
+ * Tokenizes all files at the same time, chunk by chunk. The output of each
+ * chunk is written in input order, so files written to the same stream stay
+ * in order as well.
+ */
+int ProcessFilesInParallel(BatchProcessor const &tokenizer, int argc, char *argv[], InputFactory const &open_input, OutputFactory const &open_output, std::string const &line_end, std::size_t threads, std::size_t chunk_lines) {
+	int status = 0;
+
+	// Limit how far reading can run ahead of writing
+	BoundedQueue<Chunk> queue(threads * 4);
+
+	std::thread writer([&queue] {
+		Chunk chunk;
+		for (queue.Pop(chunk); chunk.out; queue.Pop(chunk))
+			*chunk.out << chunk.text.get();
+	});
+
+	{
+		WorkStealingPool pool(threads);
+
+		int i = 0;
+		do {
+			std::string filename(i == argc ? "-" : argv[i]);
+
+			std::shared_ptr<std::istream> in(open_input(filename));
+			if (!in) {
+				status = 1;
+				continue;
+			}
+
+			std::shared_ptr<std::ostream> out(open_output(filename));
+			if (!out) {
+				status = 1;
+				continue;
+			}
+
+			while (*in) {
+				std::shared_ptr<std::vector<std::string>> lines(new std::vector<std::string>());
+				lines->reserve(chunk_lines);
+
+				std::string line;
+				while (lines->size() < chunk_lines && std::getline(*in, line))
+					lines->push_back(std::move(line));
+
+				if (lines->empty())
+					break;
+
+				std::shared_ptr<std::packaged_task<std::string()>> task(new std::packaged_task<std::string()>([&tokenizer, &line_end, lines] {
+					std::vector<std::string> tokenized;
+					tokenizer(*lines, tokenized);
+
+					std::string text;
+					for (std::string const &line : tokenized) {
+						text.append(line);
+						text.append(line_end);
+					}
+					return text;
+				}));
+
+				Chunk chunk{task->get_future(), out};
+				pool.Submit([task] { (*task)(); });
+				queue.Push(std::move(chunk));
 			}
 		} while (++i < argc);
+	}
 
-	return 0;
+	queue.Push(Chunk{}); // Tells writer we're done
+	writer.join();
+
+	return status;
+}
+
+// Read-only stream buffer over a piece of memory.
+class MemoryBuffer : public std::streambuf {
+public:
+	MemoryBuffer(char const *begin, char const *end) {
+		setg(const_cast<char *>(begin), const_cast<char *>(begin), const_cast<char *>(end));
+	}
+};
+
+// Picks the byte range [first, second) to read, given the size of the file.
+typedef std::function<std::pair<std::size_t, std::size_t>(std::size_t size)> RangeSelector;
+
+// Stream over the lines of a memory mapped file that start in the selected range.
+class MappedInput : public std::istream {
+public:
+	MappedInput(std::string const &filename, RangeSelector const &select)
+	: std::istream(nullptr),
+	  file_(filename),
+	  buffer_(nullptr, nullptr) {
+		char const *data = file_.data();
+		std::size_t size = file_.size();
+		std::size_t begin, end;
+		std::tie(begin, end) = select(size);
+		end = std::min(end, size);
+		begin = std::min(begin, end);
+
+		// A line belongs to the part its first byte is in. So skip the rest of the
+		// line that starts before begin, and finish the line that starts before end.
+		char const *first = data + LineStart(data, size, begin);
+		char const *last = data + LineStart(data, size, end);
+		buffer_ = MemoryBuffer(first, std::max(first, last));
+		rdbuf(&buffer_);
+	}
+
+private:
+	// Offset of the first line that starts at or after offset.
+	static std::size_t LineStart(char const *data, std::size_t size, std::size_t offset) {
+		if (offset == 0 || offset >= size)
+			return offset;
+
+		char const *newline = static_cast<char const *>(std::memchr(data + offset - 1, '\n', size - offset + 1));
+		return newline ? newline - data + 1 : size;
+	}
+
+	MappedFile file_;
+	MemoryBuffer buffer_;
+};
+
+/**
+ * Reads paragraphs the way split-sentences.perl does: lines are joined until a
+ * blank line, which ends the paragraph and is written as <P>, or a line that is
+ * just a tag, which is written as it is. Every sentence is written on a line of
+ * its own. Each line is decoded once and shared by the splitter and the
+ * tokenizer. Everything is tokenized, <P> and tags too, so the output is that
+ * of split-sentences.perl | tokenizer.
+ */
+void SplitAndTokenizeStream(SentenceSplitter const &splitter, Tokenizer const &tokenizer, InvalidUTF8 invalid, std::istream &in, std::ostream &out) {
+	static const string_type PARAGRAPH_MARKER{'<', 'P', '>'};
+
+	std::string line, tokenized;
+	string_type decoded, paragraph;
+	std::vector<string_type> sentences;
+
+	auto flush = [&] {
+		for (string_type const &sentence : splitter(paragraph, sentences))
+			out << tokenizer(sentence, tokenized) << '\n';
+		paragraph.clear();
+	};
+
+	while (std::getline(in, line)) {
+		StrToUChar(line, decoded, invalid);
+
+		bool blank = std::all_of(decoded.begin(), decoded.end(), [](char_type chr) { return u_isUWhiteSpace(chr); });
+		bool tag = decoded.size() > 2 && decoded.front() == '<' && decoded.back() == '>';
+
+		if (blank || tag) {
+			bool had_text = !paragraph.empty();
+			flush();
+
+			if (tag)
+				out << tokenizer(decoded, tokenized) << '\n';
+			else if (had_text)
+				out << tokenizer(PARAGRAPH_MARKER, tokenized) << '\n';
+		} else {
+			paragraph.insert(paragraph.end(), decoded.begin(), decoded.end());
+			paragraph.push_back(' ');
+		}
+	}
+
+	flush();
+	out << std::flush;
+}
+
+/**
+ * Tokenizes the text columns of a tab separated line with the tokenizer for
+ * the language in lang_column. If that is empty or a language the tokenizer
+ * doesn't know, the pool's default language is used. The other columns are
+ * copied without looking at their contents. Lines that miss any of the
+ * columns are copied as-is.
+ */
+std::string &TokenizeColumns(TokenizerPool &pool, std::size_t lang_column, std::vector<std::size_t> const &text_columns, std::string const &line, std::string &out) {
+	// Offsets of the start of each column, and one past the end of the last.
+	std::vector<std::size_t> offsets{0};
+	for (std::size_t pos = line.find('\t'); pos != std::string::npos; pos = line.find('\t', pos + 1))
+		offsets.push_back(pos + 1);
+	offsets.push_back(line.size() + 1);
+
+	std::size_t columns = offsets.size() - 1;
+	if (lang_column >= columns || *std::max_element(text_columns.begin(), text_columns.end()) >= columns) {
+		out = line;
+		return out;
+	}
+
+	std::string language(line, offsets[lang_column], offsets[lang_column + 1] - offsets[lang_column] - 1);
+	Tokenizer const &tokenizer = pool.Get(language);
+
+	std::string text, tokenized;
+	out.clear();
+	for (std::size_t column = 0; column < columns; ++column) {
+		if (column > 0)
+			out.push_back('\t');
+
+		std::size_t offset = offsets[column], length = offsets[column + 1] - offsets[column] - 1;
+		if (std::find(text_columns.begin(), text_columns.end(), column) != text_columns.end()) {
+			text.assign(line, offset, length);
+			out.append(tokenizer(text, tokenized));
+		} else {
+			out.append(line, offset, length);
+		}
+	}
+
+	return out;
+}
+
+// Parses a decimal number into value. Returns false if str is anything else,
+// so the caller can print the usage instead of dying on an exception.
+bool ParseNumber(std::string const &str, std::size_t &value) {
+	if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos)
+		return false;
+
+	try {
+		value = std::stoull(str);
+		return true;
+	} catch (std::out_of_range const &) {
+		return false;
+	}
+}
+
+// Last component of path, which is what -o-dir names the output after.
+std::string Basename(std::string const &path) {
+	return path.substr(path.find_last_of('/') + 1);
 }
 
 int TestExpression(std::string const &pattern, std::string const &replacement) {
@@ -44,6 +353,17 @@ int TestExpression(std::string const &pattern, std::string const &replacement) {
 int main(int argc, char *argv[]) {
 	std::string language("en");
 	std::string output("-");
+	std::string output_dir;
+	std::size_t threads = 1;
+	std::size_t chunk_lines = 2000;
+	std::size_t window_size = Tokenizer::DEFAULT_WINDOW_SIZE;
+	std::size_t budget_steps = 0;
+	std::size_t budget_us = 0;
+	std::size_t lang_column = 0; // 1-based, 0 means not reading tsv
+	std::vector<std::size_t> text_columns{1}; // 0-based
+	RangeSelector select_range; // only set when reading part of the input
+	bool binary = false;
+	bool split_sentences = false;
 	int filename_i = argc;
 	Tokenizer::Options options(Tokenizer::Options::none);
 
@@ -81,11 +401,22 @@ int main(int argc, char *argv[]) {
 			return 1;
 		}
 
-		else if (arg == "-threads") // Threads not implemented
-			++i;
+		else if (arg == "-threads") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
+
+			if (!ParseNumber(argv[++i], threads))
+				return usage(argv[0]);
+		}
+
+		else if (arg == "-lines") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
 
-		else if (arg == "-lines")
-			++i;
+			if (!ParseNumber(argv[++i], chunk_lines))
+				return usage(argv[0]);
+			chunk_lines = std::max(chunk_lines, std::size_t(1));
+		}
 
 		else if (arg == "-penn") {
 			std::cerr << "-penn not implemented" << std::endl;
@@ -94,6 +425,68 @@ int main(int argc, char *argv[]) {
 
 		else if (arg == "-no-escape")
 			options |= Tokenizer::Options::no_escape;
+
+		else if (arg == "-binary") {
+			binary = true;
+			options |= Tokenizer::Options::no_escape;
+		}
+
+		else if (arg == "-split-sentences")
+			split_sentences = true;
+
+		else if (arg == "-shard") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
+
+			std::string shard(argv[++i]);
+			std::size_t slash = shard.find('/');
+			if (slash == std::string::npos)
+				return usage(argv[0]);
+
+			std::size_t index, count;
+			if (!ParseNumber(shard.substr(0, slash), index) || !ParseNumber(shard.substr(slash + 1), count))
+				return usage(argv[0]);
+			if (count == 0 || index >= count)
+				return usage(argv[0]);
+
+			select_range = [index, count](std::size_t size) {
+				// size * index / count, without overflowing
+				auto offset = [size, count](std::size_t part) {
+					return size / count * part + size % count * part / count;
+				};
+				return std::make_pair(offset(index), offset(index + 1));
+			};
+		}
+
+		else if (arg == "-byte-range") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
+
+			std::string range(argv[++i]);
+			std::size_t colon = range.find(':');
+			if (colon == std::string::npos)
+				return usage(argv[0]);
+
+			std::size_t begin, end = std::string::npos;
+			if (!ParseNumber(range.substr(0, colon), begin))
+				return usage(argv[0]);
+			if (colon + 1 != range.size() && !ParseNumber(range.substr(colon + 1), end))
+				return usage(argv[0]);
+			select_range = [begin, end](std::size_t) {
+				return std::make_pair(begin, end);
+			};
+		}
+
+		else if (arg == "-invalid") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
+
+			std::string policy(argv[++i]);
+			if (policy == "pass")
+				options |= Tokenizer::Options::pass_invalid_utf8;
+			else if (policy != "replace")
+				return usage(argv[0]);
+		}
 		
 		else if (arg == "-o") {
 			if (i + 1 == argc)
@@ -102,6 +495,62 @@ int main(int argc, char *argv[]) {
 			output = argv[++i];
 		}
 
+		else if (arg == "-window") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
+
+			if (!ParseNumber(argv[++i], window_size))
+				return usage(argv[0]);
+		}
+
+		else if (arg == "-budget-steps") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
+
+			if (!ParseNumber(argv[++i], budget_steps))
+				return usage(argv[0]);
+		}
+
+		else if (arg == "-budget-us") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
+
+			if (!ParseNumber(argv[++i], budget_us))
+				return usage(argv[0]);
+		}
+
+		else if (arg == "-tsv-lang") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
+
+			if (!ParseNumber(argv[++i], lang_column) || lang_column == 0)
+				return usage(argv[0]);
+		}
+
+		else if (arg == "-tsv-text") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
+
+			text_columns.clear();
+			std::istringstream columns(argv[++i]);
+			std::string column;
+			std::size_t index;
+			while (std::getline(columns, column, ',')) {
+				if (!ParseNumber(column, index) || index == 0)
+					return usage(argv[0]);
+				text_columns.push_back(index - 1);
+			}
+			if (text_columns.empty())
+				return usage(argv[0]);
+		}
+
+		else if (arg == "-o-dir") {
+			if (i + 1 == argc)
+				return usage(argv[0]);
+
+			output_dir = argv[++i];
+		}
+
 		else if (arg == "--test"){
 			if (i + 2 >= argc)
 				return usage(argv[0]);
@@ -118,12 +567,167 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-	Tokenizer tokenizer(language, options);
+	TokenizerPool pool([=](std::string const &language) {
+		std::unique_ptr<Tokenizer> tokenizer(new Tokenizer(language, options));
+		tokenizer->SetWindowSize(window_size);
+		tokenizer->SetBudget(budget_steps, std::chrono::microseconds(budget_us));
+		return tokenizer;
+	}, language);
+
+	LineProcessor tokenizer;
+	BatchProcessor batch_tokenizer;
+	if (lang_column > 0) {
+		tokenizer = [&pool, lang_column, &text_columns](std::string const &line, std::string &out) -> std::string & {
+			return TokenizeColumns(pool, lang_column - 1, text_columns, line, out);
+		};
+		batch_tokenizer = [&tokenizer](std::vector<std::string> const &lines, std::vector<std::string> &out) {
+			out.resize(lines.size());
+			for (std::size_t i = 0; i < lines.size(); ++i)
+				tokenizer(lines[i], out[i]);
+		};
+	} else {
+		Tokenizer const &single_tokenizer = pool.Get(language);
+		tokenizer = std::cref(single_tokenizer);
+		batch_tokenizer = [&single_tokenizer](std::vector<std::string> const &lines, std::vector<std::string> &out) {
+			single_tokenizer.TokenizeBatch(lines, out);
+		};
+	}
+
+	std::string line_end("\n");
+	if (binary) {
+		if (lang_column > 0) {
+			std::cerr << "-binary can't be combined with -tsv-lang" << std::endl;
+			return 1;
+		}
+
+		line_end.clear();
+		Tokenizer const &binary_tokenizer = pool.Get(language);
+		tokenizer = [&binary_tokenizer](std::string const &line, std::string &out) -> std::string & {
+			std::vector<std::string> tokens;
+			binary_tokenizer(line, tokens);
+			out.clear();
+			EncodeTokens(tokens, out);
+			return out;
+		};
+		batch_tokenizer = [&binary_tokenizer](std::vector<std::string> const &lines, std::vector<std::string> &out) {
+			std::vector<std::vector<std::string>> tokens;
+			binary_tokenizer.TokenizeBatch(lines, tokens);
+			out.resize(tokens.size());
+			for (std::size_t i = 0; i < tokens.size(); ++i) {
+				out[i].clear();
+				EncodeTokens(tokens[i], out[i]);
+			}
+		};
+	}
+
+	InputFactory open_input;
+	if (select_range) {
+		if (argc - filename_i != 1) {
+			std::cerr << "-shard and -byte-range need exactly one input file" << std::endl;
+			return 1;
+		}
+
+		// Every part would write to the same file in the directory
+		if (!output_dir.empty()) {
+			std::cerr << "-shard and -byte-range can't be combined with -o-dir, use -o" << std::endl;
+			return 1;
+		}
+
+		open_input = [&select_range](std::string const &filename) {
+			try {
+				return std::shared_ptr<std::istream>(new MappedInput(filename, select_range));
+			} catch (std::runtime_error const &e) {
+				std::cerr << e.what() << std::endl;
+				return std::shared_ptr<std::istream>();
+			}
+		};
+	} else {
+		open_input = [](std::string const &filename) {
+			if (filename == "-")
+				return std::shared_ptr<std::istream>(&std::cin, [](std::istream *) {});
+
+			std::shared_ptr<std::istream> in(new std::ifstream(filename));
+			if (!*in) {
+				std::cerr << "Could not open " << filename << std::endl;
+				return std::shared_ptr<std::istream>();
+			}
+			return in;
+		};
+	}
+
+	// Shards are cut at lines, which could split a paragraph in two
+	if (split_sentences && (binary || lang_column > 0 || threads > 1 || !output_dir.empty() || select_range)) {
+		std::cerr << "-split-sentences can't be combined with -binary, -tsv-lang, -threads, -o-dir, -shard or -byte-range" << std::endl;
+		return 1;
+	}
+
+	if (split_sentences && !SentenceSplitter::IsSupportedLanguage(language)) {
+		std::cerr << "-split-sentences doesn't support " << language << std::endl;
+		return 1;
+	}
+
+	int status;
 
-	if (output.empty() || output == "-") {
-		return ProcessFiles(tokenizer, argc - filename_i, argv + filename_i, std::cout);
+	if (split_sentences) {
+		SentenceSplitter splitter(language);
+		InvalidUTF8 invalid = (options & Tokenizer::Options::pass_invalid_utf8) == Tokenizer::Options::pass_invalid_utf8 ? InvalidUTF8::pass : InvalidUTF8::replace;
+
+		std::shared_ptr<std::ostream> out;
+		if (output.empty() || output == "-")
+			out.reset(&std::cout, [](std::ostream *) {});
+		else
+			out.reset(new std::ofstream(output));
+
+		status = 0;
+		for (int i = filename_i; i == filename_i || i < argc; ++i) {
+			std::shared_ptr<std::istream> in(open_input(i == argc ? "-" : argv[i]));
+			if (in)
+				SplitAndTokenizeStream(splitter, pool.Get(language), invalid, *in, *out);
+			else
+				status = 1;
+		}
+	} else if (!output_dir.empty()) {
+		// Two inputs with the same name would end up interleaved in one file
+		std::set<std::string> basenames;
+		for (int i = filename_i; i < argc; ++i) {
+			if (!basenames.insert(Basename(argv[i])).second) {
+				std::cerr << "Cannot use -o-dir with two input files named " << Basename(argv[i]) << std::endl;
+				return 1;
+			}
+		}
+
+		status = ProcessFilesInParallel(batch_tokenizer, argc - filename_i, argv + filename_i, open_input, [&output_dir](std::string const &filename) {
+			if (filename == "-") {
+				std::cerr << "Cannot use -o-dir when reading from stdin" << std::endl;
+				return std::shared_ptr<std::ostream>();
+			}
+
+			std::string path = output_dir + "/" + Basename(filename);
+			std::shared_ptr<std::ostream> out(new std::ofstream(path));
+			if (!*out) {
+				std::cerr << "Could not open " << path << " for writing" << std::endl;
+				return std::shared_ptr<std::ostream>();
+			}
+			return out;
+		}, line_end, threads, chunk_lines);
+	} else if (threads > 1) {
+		std::shared_ptr<std::ostream> out;
+		if (output.empty() || output == "-")
+			out.reset(&std::cout, [](std::ostream *) {});
+		else
+			out.reset(new std::ofstream(output));
+		status = ProcessFilesInParallel(batch_tokenizer, argc - filename_i, argv + filename_i, open_input, [&out](std::string const &) {
+			return out;
+		}, line_end, threads, chunk_lines);
+	} else if (output.empty() || output == "-") {
+		status = ProcessFiles(tokenizer, argc - filename_i, argv + filename_i, open_input, std::cout, line_end);
 	} else {
 		std::ofstream out(output);
-		return ProcessFiles(tokenizer, argc - filename_i, argv + filename_i, out);
+		status = ProcessFiles(tokenizer, argc - filename_i, argv + filename_i, open_input, out, line_end);
 	}
+
+	if (budget_steps > 0 || budget_us > 0)
+		std::cerr << pool.FallbackCount() << " lines exceeded the budget and were tokenized with the fallback tokenizer" << std::endl;
+
+	return status;
 }